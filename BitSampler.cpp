@@ -0,0 +1,78 @@
+#include "BitSampler.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ 
+ ****************************
+ *        BitSampler        *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+ 
+ The BitSampler class draws bit strings from a vector of per-bit probabilities without
+ a floating point comparison per bit. Each probability p becomes the threshold
+ t = p * 2^32, and a bit is set when a uniform random 32-bit integer is below t. Every
+ random 64-bit word therefore decides two bits, and with SSE2 four bits are decided per
+ comparison, whose results are gathered straight into the packed word by a movemask.
+ 
+ SSE2 only compares signed integers, so thresholds are stored with their sign bit
+ flipped, which turns the unsigned order into the signed one. The random integers are
+ left as they are: flipping the sign bit of a uniform integer leaves it uniform, so
+ comparing the raw integer (as signed) against the flipped threshold is the same as
+ comparing some other uniform integer against the threshold itself.
+ 
+*/
+
+/*
+ Converts a probability vector into thresholds for sampling
+ Parameters:
+        probVect: The probability of each bit being set
+*/
+void BitSampler::setProbabilities(const std::vector<double>& probVect)
+{
+    numBits = probVect.size();
+    thresholds.assign(static_cast<size_t>(getNumWords()) * 64, toThreshold(0.0));
+    for (int i = 0; i < numBits; i++)
+        thresholds[i] = toThreshold(probVect[i]);
+}
+
+/*
+ Draws bit strings from the thresholds set by setProbabilities. Bits past the last
+ probability in the final word of each string are always 0
+ Parameters:
+        rng: Random stream to draw from
+        out: Output, count consecutive bit strings of getNumWords() words each
+        count: Number of bit strings to draw
+*/
+void BitSampler::sample(Random& rng, uint64_t* out, int count) const
+{
+    int numWords = getNumWords();
+    uint64_t random[32];
+    
+    for (int s = 0; s < count; s++) {
+        uint64_t* words = out + static_cast<size_t>(s) * numWords;
+        const int32_t* t = thresholds.data();
+        for (int k = 0; k < numWords; k++, t += 64) {
+            for (int j = 0; j < 32; j++)
+                random[j] = rng.nextWord();
+            
+            uint64_t word = 0;
+#ifdef __SSE2__
+            for (int j = 0; j < 16; j++) {
+                __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(random + 2 * j));
+                __m128i below = _mm_cmplt_epi32(r, _mm_loadu_si128(reinterpret_cast<const __m128i*>(t + 4 * j)));
+                word |= static_cast<uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(below))) << (4 * j);
+            }
+#else
+            for (int j = 0; j < 64; j++) {
+                int32_t r = static_cast<int32_t>(static_cast<uint32_t>(random[j >> 1] >> (32 * (j & 1))));
+                word |= static_cast<uint64_t>(r < t[j]) << j;
+            }
+#endif
+            words[k] = word;
+        }
+    }
+}
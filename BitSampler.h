@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Random.h"
+
+#include <cstdint>
+#include <vector>
+
+/*
+ 
+ ****************************
+ *        BitSampler        *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+ 
+ See BitSampler.cpp for more documentation.
+ 
+*/
+
+// Samples packed bit strings (variable i is bit i % 64 of word i / 64) in which each
+// bit is set independently with its own probability, as PBIL does from its probability
+// vector. The probabilities are converted to fixed-point thresholds once, after which
+// any number of bit strings can be drawn from them.
+// Class and method documentation can be found in BitSampler.cpp
+class BitSampler {
+public:
+    BitSampler() : numBits(0) {}
+    
+    // Converts the probabilities to thresholds, until the next call
+    void setProbabilities(const std::vector<double>& probVect);
+    
+    // Changes the probability of a single bit
+    void setProbability(int index, double p) { thresholds[index] = toThreshold(p); }
+    
+    // Reads or sets the probability of a single bit as a fixed-point fraction of 2^32
+    uint32_t getThreshold(int index) const { return static_cast<uint32_t>(thresholds[index]) ^ 0x80000000u; }
+    void setThreshold(int index, uint32_t t) { thresholds[index] = static_cast<int32_t>(t ^ 0x80000000u); }
+    
+    // Words in each sampled bit string
+    int getNumWords() const { return (numBits + 63) >> 6; }
+    
+    // Draws count bit strings one after another into out, which must hold
+    // count * getNumWords() words
+    void sample(Random& rng, uint64_t* out, int count) const;
+
+private:
+    static int32_t toThreshold(double p)
+    {
+        uint32_t t = p <= 0.0 ? 0 : p >= 1.0 ? 0xFFFFFFFFu : static_cast<uint32_t>(p * 4294967296.0);
+        return static_cast<int32_t>(t ^ 0x80000000u);
+    }
+    
+    int numBits;
+    
+    // The probability of each bit as a 32-bit fixed-point threshold, stored with its
+    // sign bit flipped (see BitSampler.cpp), padded with never set bits to a whole
+    // number of words
+    std::vector<int32_t> thresholds;
+};
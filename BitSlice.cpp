@@ -0,0 +1,171 @@
+#include "BitSlice.h"
+#include "BitSliceKernel.h"
+
+#include <vector>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+ 
+ ****************************
+ *         BitSlice         *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+ 
+ This file contains the scalar and SSE2 bit-sliced MAXSAT kernels, and the runtime
+ choice of kernel. Rather than scoring one genome at a time, a kernel scores a whole
+ batch of genomes per pass over the clauses, one genome per bit of its lanes (see
+ BitSliceKernel.h). The AVX2 kernel lives in BitSliceAVX2.cpp, since it needs its
+ own compiler flags.
+ 
+*/
+
+// Scalar lanes: one 64-bit word, 64 genomes per pass
+struct ScalarLane {
+    typedef uint64_t V;
+    static const int words = 1;
+    static V load(const uint64_t* p) { return *p; }
+    static void store(uint64_t* p, V v) { *p = v; }
+    static V zero() { return 0; }
+    static V ones() { return ~static_cast<uint64_t>(0); }
+    static V bitOr(V a, V b) { return a | b; }
+    static V bitXor(V a, V b) { return a ^ b; }
+    static V bitAnd(V a, V b) { return a & b; }
+    static bool isZero(V v) { return v == 0; }
+};
+
+void bitSliceScalar(const BitSliceProblem& problem, const uint64_t* const* genomes, int count,
+                    uint64_t* rows, int* fitness)
+{
+    bitSliceEvaluate<ScalarLane>(problem, genomes, count, rows, fitness);
+}
+
+#ifdef __SSE2__
+// SSE2 lanes: two 64-bit words, 128 genomes per pass
+struct SSE2Lane {
+    typedef __m128i V;
+    static const int words = 2;
+    static V load(const uint64_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    static void store(uint64_t* p, V v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    static V zero() { return _mm_setzero_si128(); }
+    static V ones() { return _mm_set1_epi32(-1); }
+    static V bitOr(V a, V b) { return _mm_or_si128(a, b); }
+    static V bitXor(V a, V b) { return _mm_xor_si128(a, b); }
+    static V bitAnd(V a, V b) { return _mm_and_si128(a, b); }
+    static bool isZero(V v) { return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128())) == 0xFFFF; }
+};
+
+void bitSliceSSE2(const BitSliceProblem& problem, const uint64_t* const* genomes, int count,
+                  uint64_t* rows, int* fitness)
+{
+    bitSliceEvaluate<SSE2Lane>(problem, genomes, count, rows, fitness);
+}
+
+bool bitSliceHasSSE2()
+{
+    return true;
+}
+#else
+void bitSliceSSE2(const BitSliceProblem& problem, const uint64_t* const* genomes, int count,
+                  uint64_t* rows, int* fitness)
+{
+    bitSliceScalar(problem, genomes, count, rows, fitness);
+}
+
+bool bitSliceHasSSE2()
+{
+    return false;
+}
+#endif
+
+/*
+ Returns whether the AVX2 kernel was built and the running CPU supports it
+*/
+bool bitSliceHasAVX2()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    return bitSliceAVX2Built && __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+// The kernel chosen for this CPU, its batch size and its name
+struct KernelChoice {
+    BitSliceKernel kernel;
+    int batchSize;
+    const char* name;
+};
+
+/*
+ Picks the widest kernel that both this build and the running CPU support
+*/
+static KernelChoice chooseKernel()
+{
+    KernelChoice choice;
+    if (bitSliceHasAVX2()) {
+        choice.kernel = bitSliceAVX2;
+        choice.batchSize = 256;
+        choice.name = "AVX2";
+    } else if (bitSliceHasSSE2()) {
+        choice.kernel = bitSliceSSE2;
+        choice.batchSize = 128;
+        choice.name = "SSE2";
+    } else {
+        choice.kernel = bitSliceScalar;
+        choice.batchSize = 64;
+        choice.name = "scalar";
+    }
+    return choice;
+}
+
+static const KernelChoice& kernelChoice()
+{
+    static const KernelChoice choice = chooseKernel();
+    return choice;
+}
+
+BitSliceKernel bitSliceKernel()
+{
+    return kernelChoice().kernel;
+}
+
+int bitSliceBatchSize()
+{
+    return kernelChoice().batchSize;
+}
+
+const char* bitSliceKernelName()
+{
+    return kernelChoice().name;
+}
+
+/*
+ Scores any number of genomes with the chosen kernel, a batch at a time
+ Parameters:
+        cnf: The problem to score against
+        genomes: Pointers to the packed genomes
+        count: Number of genomes
+        fitness: Output, the number of satisfied clauses of each genome
+*/
+void evaluateBitSliced(const CNF& cnf, const uint64_t* const* genomes, int count, int* fitness)
+{
+    BitSliceProblem problem;
+    problem.literals = cnf.getLiterals();
+    problem.offsets = cnf.getOffsets();
+    problem.numClauses = cnf.getNumClauses();
+    problem.numVars = cnf.getNumVars();
+    
+    // The transposition scratch space is kept per thread and reused between calls
+    const KernelChoice& choice = kernelChoice();
+    static thread_local std::vector<uint64_t> rows;
+    rows.resize(bitSliceRowWords(problem.numVars, choice.batchSize));
+    for (int first = 0; first < count; first += choice.batchSize) {
+        int batch = std::min(choice.batchSize, count - first);
+        choice.kernel(problem, genomes + first, batch, rows.data(), fitness + first);
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "readCNF.h"
+
+#include <cstdint>
+
+/*
+ 
+ ****************************
+ *         BitSlice         *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+ 
+ See BitSlice.cpp for more documentation.
+ 
+*/
+
+// The raw clause database a kernel scores against (see CNF in readCNF.h)
+struct BitSliceProblem {
+    const unsigned int* literals;
+    const unsigned int* offsets;
+    int numClauses;
+    int numVars;
+};
+
+// Signature shared by the bit-sliced MAXSAT kernels. Each kernel scores a batch of
+// up to its batch size of packed genomes against every clause of the problem,
+// writing the number of satisfied clauses of genome i to fitness[i]. rows is scratch
+// space of at least bitSliceRowWords(numVars, batch size) words.
+typedef void (*BitSliceKernel)(const BitSliceProblem& problem, const uint64_t* const* genomes, int count,
+                               uint64_t* rows, int* fitness);
+
+// The kernels, scoring 64 (scalar), 128 (SSE2) or 256 (AVX2) genomes per clause pass.
+// The SIMD kernels fall back to narrower ones when the build does not support them,
+// and the AVX2 kernel must only be run when bitSliceHasAVX2 returns true.
+void bitSliceScalar(const BitSliceProblem& problem, const uint64_t* const* genomes, int count,
+                    uint64_t* rows, int* fitness);
+void bitSliceSSE2(const BitSliceProblem& problem, const uint64_t* const* genomes, int count,
+                  uint64_t* rows, int* fitness);
+void bitSliceAVX2(const BitSliceProblem& problem, const uint64_t* const* genomes, int count,
+                  uint64_t* rows, int* fitness);
+bool bitSliceHasSSE2();
+bool bitSliceHasAVX2();
+
+// Whether BitSliceAVX2.cpp was compiled with AVX2 enabled
+extern const bool bitSliceAVX2Built;
+
+// Size of the scratch space a kernel needs, in words
+inline size_t bitSliceRowWords(int numVars, int batchSize) { return static_cast<size_t>((numVars + 63) >> 6) * batchSize; }
+
+// The fastest kernel supported by the running CPU, chosen once at startup,
+// along with its batch size and name
+BitSliceKernel bitSliceKernel();
+int bitSliceBatchSize();
+const char* bitSliceKernelName();
+
+// Scores count (any number of) genomes with the chosen kernel, in batches
+void evaluateBitSliced(const CNF& cnf, const uint64_t* const* genomes, int count, int* fitness);
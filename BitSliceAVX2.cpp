@@ -0,0 +1,53 @@
+#include "BitSlice.h"
+#include "BitSliceKernel.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/*
+ 
+ ****************************
+ *       BitSliceAVX2       *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+ 
+ This file contains the AVX2 bit-sliced MAXSAT kernel (see BitSlice.cpp). It is
+ compiled with AVX2 enabled, so nothing here may run before bitSliceHasAVX2 has
+ confirmed that the CPU supports it; that check lives in BitSlice.cpp for the same
+ reason.
+ 
+*/
+
+#ifdef __AVX2__
+// AVX2 lanes: four 64-bit words, 256 genomes per pass
+struct AVX2Lane {
+    typedef __m256i V;
+    static const int words = 4;
+    static V load(const uint64_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+    static void store(uint64_t* p, V v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+    static V zero() { return _mm256_setzero_si256(); }
+    static V ones() { return _mm256_set1_epi32(-1); }
+    static V bitOr(V a, V b) { return _mm256_or_si256(a, b); }
+    static V bitXor(V a, V b) { return _mm256_xor_si256(a, b); }
+    static V bitAnd(V a, V b) { return _mm256_and_si256(a, b); }
+    static bool isZero(V v) { return _mm256_testz_si256(v, v); }
+};
+
+void bitSliceAVX2(const BitSliceProblem& problem, const uint64_t* const* genomes, int count,
+                  uint64_t* rows, int* fitness)
+{
+    bitSliceEvaluate<AVX2Lane>(problem, genomes, count, rows, fitness);
+}
+
+const bool bitSliceAVX2Built = true;
+#else
+void bitSliceAVX2(const BitSliceProblem& problem, const uint64_t* const* genomes, int count,
+                  uint64_t* rows, int* fitness)
+{
+    bitSliceSSE2(problem, genomes, count, rows, fitness);
+}
+
+const bool bitSliceAVX2Built = false;
+#endif
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "BitSlice.h"
+
+#include <cstdint>
+
+/*
+ 
+ ****************************
+ *      BitSliceKernel      *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+ 
+ The generic bit-sliced MAXSAT kernel, included by BitSlice.cpp and BitSliceAVX2.cpp
+ so that each can instantiate it for the lane types its compiler flags allow.
+ Since BitSliceAVX2.cpp is compiled with AVX2 enabled, nothing here may use library
+ templates or inline functions from other headers, which the linker could otherwise
+ share with code that runs on CPUs without AVX2.
+ 
+ A batch of genomes is first transposed so that each variable becomes a row of
+ bits, one bit per genome. A clause is then the OR of its (possibly complemented)
+ variable rows, giving in one operation whether each genome in the batch satisfies
+ it. The complement of that row (the unsatisfied genomes) is added into a
+ bit-sliced vertical counter: plane b holds bit b of every genome's count, and a
+ ripple carry adds a whole row at once, stopping as soon as the carry is empty.
+ 
+ A Lane type provides the vector type V of Lane::words 64-bit words and the
+ operations load, store, zero, ones, bitOr, bitXor, bitAnd and isZero.
+ 
+*/
+
+/*
+ Transposes a 64x64 bit matrix in place, so that afterwards bit j of a[i] is what
+ bit i of a[j] was before
+*/
+static inline void transpose64(uint64_t a[64])
+{
+    uint64_t m = 0x00000000FFFFFFFFULL;
+    for (int j = 32; j != 0; j >>= 1, m ^= (m << j)) {
+        for (int k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+            uint64_t t = ((a[k] >> j) ^ a[k | j]) & m;
+            a[k | j] ^= t;
+            a[k] ^= (t << j);
+        }
+    }
+}
+
+/*
+ Scores a batch of genomes with the given lane type
+ Parameters:
+        problem: The clauses to score against
+        genomes: Pointers to the packed genomes of the batch
+        count: Number of genomes in the batch, at most 64 * Lane::words
+        rows: Scratch space for the transposed batch
+        fitness: Output, the number of satisfied clauses of each genome
+*/
+template <class Lane>
+void bitSliceEvaluate(const BitSliceProblem& problem, const uint64_t* const* genomes, int count,
+                      uint64_t* rows, int* fitness)
+{
+    typedef typename Lane::V V;
+    const int W = Lane::words;
+    int numWords = (problem.numVars + 63) >> 6;
+    
+    // Transpose the batch, 64 genomes by 64 variables at a time, so that
+    // rows[v * W + w] holds variable v of genomes w * 64 up to w * 64 + 63
+    uint64_t block[64];
+    for (int k = 0; k < numWords; k++) {
+        for (int w = 0; w < W; w++) {
+            for (int j = 0; j < 64; j++) {
+                int g = w * 64 + j;
+                block[j] = g < count ? genomes[g][k] : 0;
+            }
+            transpose64(block);
+            for (int b = 0; b < 64; b++)
+                rows[(static_cast<size_t>(k) * 64 + b) * W + w] = block[b];
+        }
+    }
+    
+    // Count the unsatisfied clauses of every genome with a vertical counter
+    const unsigned int* literals = problem.literals;
+    const unsigned int* offsets = problem.offsets;
+    int numClauses = problem.numClauses;
+    
+    V planes[32];
+    for (int b = 0; b < 32; b++)
+        planes[b] = Lane::zero();
+    const V flip[2] = { Lane::zero(), Lane::ones() };
+    
+    for (int c = 0; c < numClauses; c++) {
+        V satisfied = Lane::zero();
+        for (unsigned int j = offsets[c]; j < offsets[c + 1]; j++) {
+            unsigned int lit = literals[j];
+            V row = Lane::load(&rows[static_cast<size_t>(lit >> 1) * W]);
+            satisfied = Lane::bitOr(satisfied, Lane::bitXor(row, flip[lit & 1]));
+        }
+        
+        V carry = Lane::bitXor(satisfied, Lane::ones());
+        for (int b = 0; !Lane::isZero(carry); b++) {
+            V next = Lane::bitAnd(planes[b], carry);
+            planes[b] = Lane::bitXor(planes[b], carry);
+            carry = next;
+        }
+    }
+    
+    // Read each genome's count back out of the planes
+    uint64_t plane[32][W];
+    for (int b = 0; b < 32; b++)
+        Lane::store(plane[b], planes[b]);
+    for (int g = 0; g < count; g++) {
+        long long unsatisfied = 0;
+        for (int b = 0; b < 32; b++)
+            unsatisfied |= static_cast<long long>((plane[b][g >> 6] >> (g & 63)) & 1) << b;
+        fitness[g] = numClauses - static_cast<int>(unsatisfied);
+    }
+}
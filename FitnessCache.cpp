@@ -0,0 +1,115 @@
+#include "FitnessCache.h"
+
+/*
+ 
+ ****************************
+ *       FitnessCache       *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+ 
+ The FitnessCache class remembers the fitness of recently scored genomes by their
+ 64-bit hash (see MAXSATIndividual), so that duplicates, which selection produces
+ often, cost one lookup instead of a pass over every clause.
+ 
+ The table is direct mapped: the low bits of a hash pick its slot. A slot holds the
+ fitness, marked with a valid bit, and that word XORed with the hash, written as two
+ separate words. A reader accepts a slot only if the valid bit is set and XORing the
+ two words it read gives back its hash, so a slot caught halfway through being
+ overwritten by another thread (whose two words then come from different writes) is
+ rejected rather than misread, without any locking, and an empty slot (all zero)
+ matches nothing.
+ 
+ Hits and lookups are counted per thread rather than in one shared pair of counters,
+ which every thread would otherwise write on every lookup, and summed when reported.
+ 
+*/
+
+// Marks a slot's value word as holding a fitness (fitness is never negative, so it
+// never reaches this bit)
+static const uint64_t VALID_BIT = static_cast<uint64_t>(1) << 63;
+
+/*
+ Creates an empty cache
+ Parameters:
+        numEntries: The number of slots, rounded up to a power of two
+*/
+FitnessCache::FitnessCache(int numEntries)
+{
+    uint64_t size = 1;
+    while (size < static_cast<uint64_t>(numEntries))
+        size <<= 1;
+    mask = size - 1;
+    
+    entries.reset(new Entry[size]);
+    for (uint64_t i = 0; i < size; i++) {
+        entries[i].value.store(0, std::memory_order_relaxed);
+        entries[i].check.store(0, std::memory_order_relaxed);
+    }
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        counters[i].lookups.store(0, std::memory_order_relaxed);
+        counters[i].hits.store(0, std::memory_order_relaxed);
+    }
+}
+
+/*
+ Finds the fitness stored for a genome
+ Parameters:
+        hash: The genome's hash
+        fitness: Output, the stored fitness if there is one
+ Returns whether the fitness was found
+*/
+bool FitnessCache::lookup(uint64_t hash, int& fitness)
+{
+    // Each thread takes the next counter the first time it looks anything up
+    static std::atomic<int> nextCounter(0);
+    static thread_local int counterIndex = nextCounter.fetch_add(1) % NUM_COUNTERS;
+    Counter& counter = counters[counterIndex];
+    
+    counter.lookups.fetch_add(1, std::memory_order_relaxed);
+    const Entry& entry = entries[hash & mask];
+    uint64_t value = entry.value.load(std::memory_order_relaxed);
+    uint64_t check = entry.check.load(std::memory_order_relaxed);
+    if (!(value & VALID_BIT) || (check ^ value) != hash)
+        return false;
+    
+    counter.hits.fetch_add(1, std::memory_order_relaxed);
+    fitness = static_cast<int>(value & ~VALID_BIT);
+    return true;
+}
+
+/*
+ Stores the fitness of a genome, replacing whichever genome had its slot
+ Parameters:
+        hash: The genome's hash
+        fitness: Its fitness
+*/
+void FitnessCache::store(uint64_t hash, int fitness)
+{
+    Entry& entry = entries[hash & mask];
+    uint64_t value = static_cast<uint64_t>(fitness) | VALID_BIT;
+    entry.value.store(value, std::memory_order_relaxed);
+    entry.check.store(hash ^ value, std::memory_order_relaxed);
+}
+
+/*
+ Returns the number of lookups made so far by every thread
+*/
+uint64_t FitnessCache::getLookups() const
+{
+    uint64_t total = 0;
+    for (int i = 0; i < NUM_COUNTERS; i++)
+        total += counters[i].lookups.load(std::memory_order_relaxed);
+    return total;
+}
+
+/*
+ Returns the number of lookups so far, by every thread, that found a fitness
+*/
+uint64_t FitnessCache::getHits() const
+{
+    uint64_t total = 0;
+    for (int i = 0; i < NUM_COUNTERS; i++)
+        total += counters[i].hits.load(std::memory_order_relaxed);
+    return total;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+/*
+ 
+ ****************************
+ *       FitnessCache       *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+ 
+ See FitnessCache.cpp for more documentation.
+ 
+*/
+
+// A fixed size table from genome hashes to fitness, shared by every thread of a run so
+// that a genome seen before is not scored again. Each hash has one slot, and a newer
+// genome simply replaces the one there. Reads and writes never lock.
+// Class and method documentation can be found in FitnessCache.cpp
+class FitnessCache {
+public:
+    explicit FitnessCache(int numEntries);
+    
+    // Finds the fitness stored for a hash, returning false if there is none
+    bool lookup(uint64_t hash, int& fitness);
+    void store(uint64_t hash, int fitness);
+    
+    int getNumEntries() const { return static_cast<int>(mask + 1); }
+    uint64_t getLookups() const;
+    uint64_t getHits() const;
+
+private:
+    struct Entry {
+        std::atomic<uint64_t> check;
+        std::atomic<uint64_t> value;
+    };
+    
+    // Lookup counts of the threads whose counter index (see lookup) lands on a slot,
+    // padded so that threads with different slots never write the same cache line
+    struct Counter {
+        std::atomic<uint64_t> lookups;
+        std::atomic<uint64_t> hits;
+        char padding[64 - 2 * sizeof(std::atomic<uint64_t>)];
+    };
+    static const int NUM_COUNTERS = 64;
+    
+    std::unique_ptr<Entry[]> entries;
+    uint64_t mask;
+    Counter counters[NUM_COUNTERS];
+};
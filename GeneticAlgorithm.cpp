@@ -2,6 +2,11 @@
 #include "readCNF.h"
 #include "PBIL.h"
 
+#include <map>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+
 /*
  
  ****************************
@@ -31,7 +36,20 @@
       mutationProb: Probability that a bred individual's information will be mutated
       numOfGenerations: Number of iterations the GA will run
       maxSolution_: Maximum solution for the abstract problem (different than the best POSSIBLE solution)
-      numVars_: The number of variables in the problem
+      problem_: The problem being solved, referenced when printing results
+      numThreads_: Number of threads to evaluate and breed the population with
+      seed_: Seed of the run, from which each thread's random stream is split
+      temperature_: Temperature for boltzmann selection
+      preprocessor_: How problem_ was simplified from the original problem, used to report
+          results in terms of the original (NULL if it was not)
+      islandSettings_: How to split the population into islands (by default it is not)
+      shared_: Segment to exchange individuals through with other processes solving the
+          same problem (NULL to run alone)
+      localSearch_: How to improve offspring by local search (by default they are not)
+      mutationMethod_: How to pick the bits offspring mutate (uniformly by default)
+      engine_: The run loops for the type of the individuals (see engine), which must be
+          the type of every individual in initialPopulation. By default the loops for
+          Individual are used, which work for any subclass
 */
 GeneticAlgorithm::GeneticAlgorithm(std::vector<std::shared_ptr<Individual>> initialPopulation,
                                    SelectionMethod selectionMethod, 
@@ -40,18 +58,61 @@ GeneticAlgorithm::GeneticAlgorithm(std::vector<std::shared_ptr<Individual>> init
                                    double mutationProb,
                                    int numOfGenerations,
                                    double maxSolution_,
-                                   int numVars_)
-: currentGeneration(0), population(initialPopulation), maxSolution(maxSolution_), numVars(numVars_)
+                                   const CNF& problem_,
+                                   int numThreads_,
+                                   uint64_t seed_,
+                                   double temperature_,
+                                   const Preprocessor* preprocessor_,
+                                   const IslandSettings& islandSettings_,
+                                   SharedMigration* shared_,
+                                   const LocalSearchSettings& localSearch_,
+                                   MutationMethod mutationMethod_,
+                                   Engine engine_)
+: currentGeneration(0), population(initialPopulation), maxSolution(maxSolution_), problem(problem_),
+  preprocessor(preprocessor_), numThreads(numThreads_ < 1 ? 1 : numThreads_), seed(seed_), temperature(temperature_),
+  islandSettings(islandSettings_), shared(shared_), mutationMethod(mutationMethod_),
+  localSearch(localSearch_), runLoops(engine_ ? engine_ : engine<Individual>())
 {
     // Actually run the Genetic Algorithm
-    run(selectionMethod, crossoverMethod, crossoverProb,
-        mutationProb, numOfGenerations);
+    (this->*runLoops)(selectionMethod, crossoverMethod, crossoverProb,
+                      mutationProb, numOfGenerations);
+}
+
+/*
+ Runs the GA on individuals of type Ind, as an island model if it is split into islands
+ Parameters:
+      selectionMethod: Parsed info to send to Sampler in order to specify GA selection
+      crossoverMethod: Parsed info in order to specify GA crossover during breeding
+      crossoverProb: Probability that indiviudals will crossover during breeding
+      mutationProb: Probability that a bred individual's information will be mutated
+      numOfGenerations: Number of iterations the GA will run
+*/
+template <class Ind>
+void GeneticAlgorithm::runAs(SelectionMethod selectionMethod,
+                             CrossoverMethod crossoverMethod,
+                             double crossoverProb,
+                             double mutationProb,
+                             int numOfGenerations)
+{
+    if (islandSettings.numIslands > 1)
+        runIslands<Ind>(selectionMethod, crossoverMethod, crossoverProb,
+                        mutationProb, numOfGenerations);
+    else
+        run<Ind>(selectionMethod, crossoverMethod, crossoverProb,
+                 mutationProb, numOfGenerations);
 }
 
 /*
  Performs the fitness-based generation of a population of abstract individuals,
  breeding selected individuals for the next generation and potentially crossing over and
- mutating the offspring in order to generate better solutions from the population
+ mutating the offspring in order to generate better solutions from the population.
+ Each generation, the population is split into one chunk per thread for evaluation,
+ and the next generation is split the same way, each thread filling its own chunk
+ with offspring drawn from its own random stream. For a fixed seed and thread count
+ the run is therefore reproducible. The population is double buffered: offspring
+ overwrite the individuals of the previous generation, and the two buffers swap roles
+ every generation, so after the first generation no individuals are allocated.
+ Both buffers are also held by the individuals' type Ind, for evaluation and breeding.
  Parameters:
       selectionMethod: Parsed info to send to Sampler in order to specify GA selection
       crossoverMethod: Parsed info in order to specify GA crossover during breeding
@@ -59,6 +120,7 @@ GeneticAlgorithm::GeneticAlgorithm(std::vector<std::shared_ptr<Individual>> init
       mutationProb: Probability that a bred individual's information will be mutated
       numOfGenerations: Number of iterations the GA will run
 */
+template <class Ind>
 void GeneticAlgorithm::run(SelectionMethod selectionMethod,
                           CrossoverMethod crossoverMethod,
                           double crossoverProb,
@@ -71,67 +133,113 @@ void GeneticAlgorithm::run(SelectionMethod selectionMethod,
     topGeneration = 0;
     topIndividual = NULL;
     success = false;
+    stoppedByOther = false;
+    
+    // One random stream per chunk of work, so results don't depend on which
+    // thread happens to run which chunk. Stream 0 of the seed belongs to main
+    ThreadPool pool(numThreads);
+    int numChunks = pool.size();
+    std::vector<Random> rngs;
+    for (int i = 0; i < numChunks; i++)
+        rngs.push_back(Random(seed, i + 1));
+    
+    // Allocate the second buffer of the population, which the offspring are
+    // written into, and a spare individual per chunk for offspring that don't fit
+    // in the chunk. After this, generations only overwrite existing individuals
+    nextGeneration.clear();
+    for (unsigned int i = 0; i < population.size(); i++)
+        nextGeneration.push_back(population[i]->clone());
+    std::vector<std::shared_ptr<Individual>> spares;
+    for (int i = 0; i < numChunks && !population.empty(); i++)
+        spares.push_back(population[0]->clone());
+    std::vector<Ind*> current = typedIndividuals<Ind>(population);
+    std::vector<Ind*> next = typedIndividuals<Ind>(nextGeneration);
+    std::vector<Ind*> typedSpares = typedIndividuals<Ind>(spares);
+    
+    // Construct the sampler with the supplied selection method. It refers to the
+    // population vector, whose contents are swapped with each new generation
+    Sampler sampler(selectionMethod, population, evaluations, temperature);
+    
+    // The breeding kernel for the run's individuals, selection and crossover
+    BreedKernel<Ind> breed = breedKernel<Ind>(selectionMethod, crossoverMethod);
+    
+    // Buffers for exchanging individuals with other processes
+    std::vector<int> order;
+    std::vector<std::shared_ptr<Individual>> arrivals;
+    uint64_t cursor = 0;
+    for (int i = 0; shared && i < shared->getNumMigrants() && !population.empty(); i++)
+        arrivals.push_back(population[0]->clone());
     
     while (++currentGeneration <= numOfGenerations) {
         
         // Make sure the evaluations from the old populations are gone
         // and get the new evaluations (so they don't have to be calculated
-        // on the fly in different selection methods)
-        evaluations.clear();
-        for(unsigned int i = 0; i < population.size(); i++) {
-            evaluations.push_back(population[i]->evaluateFitness());
-        }
+        // on the fly in different selection methods). Individuals carry their
+        // fitness with them, so only those changed since being scored are rescored,
+        // and each thread scores its chunk as a batch
+        evaluations.assign(population.size(), 0.0);
+        pool.run(numChunks, [&](int chunk) {
+            int begin = chunkBegin(chunk, numChunks, population.size());
+            int end = chunkBegin(chunk + 1, numChunks, population.size());
+            Ind::evaluateBatch(current.data() + begin, end - begin, evaluations.data() + begin);
+        });
         
         // Get the best individual from the population
         bestFitIndex = getBestIndividual();
         
-        // Assess the best EVER individual of all generations and store it
-        // in case the maximum solution isn't achieved
-        if (evaluations[bestFitIndex] > topFitness) {
+        // Assess the best EVER individual of all generations and store a copy of it
+        // in case the maximum solution isn't achieved (the population's own
+        // individuals are overwritten by later generations)
+        if (evaluations[bestFitIndex] > topFitness || !topIndividual) {
             topFitness = evaluations[bestFitIndex];
-            topIndividual = population[bestFitIndex];
+            if (topIndividual)
+                topIndividual->copyFrom(*population[bestFitIndex]);
+            else
+                topIndividual = population[bestFitIndex]->clone();
             topGeneration = currentGeneration;
         }
         
         // If there is the maximum possible fitness given the (generic) problem,
         // end the algorithm and display that best individual
         if (topFitness == maxSolution) {
+            if (shared) {
+                shared->offerBest(*topIndividual, topFitness);
+                shared->requestStop();
+            }
             printSuccess();
             success = true;
             break;
         }
         
-        // Make the vector for the next generation and construct
-        // the sampler with the supplied selection method
-        std::vector<std::shared_ptr<Individual>> nextGeneration;
-        Sampler sampler(selectionMethod, population, evaluations);
-
-        // Breed the current generation and send the individuals to the next generation
-        while (nextGeneration.size() != population.size()) {
-            std::pair<std::shared_ptr<Individual>, std::shared_ptr<Individual>> offspring;
-
-            // With probability crossoverProb, breed two Individuals
-            if (static_cast<double>(rand()) / RAND_MAX < crossoverProb) {
-                offspring = sampler.select()->breed(crossoverMethod, *(sampler.select()));
-            } else { // Else, just take an Individual
-                offspring.first = sampler.select();
-            }
-
-            // With probability mutationProb, mutate the Individual (or pair of individuals)
-            offspring.first->mutate(mutationProb);
-            if (offspring.second) {
-                offspring.second->mutate(mutationProb);
+        // Trade individuals with the other processes every few generations, and
+        // stop once one of them has found a complete solution
+        if (shared) {
+            if (shared->stopRequested()) {
+                stoppedByOther = true;
+                break;
             }
-
-            // Add individual (or pair) to the next generation
-            nextGeneration.push_back(offspring.first);
-            if (offspring.second && nextGeneration.size() < population.size()) {
-                nextGeneration.push_back(offspring.second);
+            if (currentGeneration % shared->getInterval() == 0) {
+                shared->offerBest(*topIndividual, topFitness);
+                exchangeShared(population, evaluations, order, arrivals, cursor);
             }
         }
+        
+        // Prepare the sampler for this generation's population
+        sampler.update();
+
+        // Breed the current generation and send the individuals to the next generation,
+        // each thread filling its own chunk of the next generation
+        pool.run(numChunks, [&](int chunk) {
+            breed(current.data(), next.data(),
+                  chunkBegin(chunk, numChunks, nextGeneration.size()),
+                  chunkBegin(chunk + 1, numChunks, nextGeneration.size()),
+                  *typedSpares[chunk], sampler, crossoverProb, mutationMethod, mutationProb,
+                  localSearch, rngs[chunk]);
+        });
 
-        // Move the std::move is efficient, as it avoids copying the entire vector
-        population = std::move(nextGeneration);
+        // Swap the buffers, so the old generation's individuals are overwritten next time
+        population.swap(nextGeneration);
+        current.swap(next);
         
         std::cout << "Generation: " << currentGeneration << std::endl;
     }
@@ -141,6 +249,228 @@ void GeneticAlgorithm::run(SelectionMethod selectionMethod,
         printEnd();
 }
 
+/*
+ Performs the island model version of the GA. The population is split into islands, and
+ each island is evolved by its own thread the same way run() evolves the whole population.
+ Every islandSettings.interval generations, an island copies its best individuals into the
+ mailboxes of its neighbours and replaces its worst individuals with any migrants waiting
+ in its own mailboxes. Islands never wait for each other, not even between generations;
+ the first island to reach maxSolution tells the others to stop. Since migrants arrive
+ whenever the sending island gets to them, an island run is not reproducible from its seed.
+ Parameters:
+      selectionMethod: Parsed info to send to Sampler in order to specify GA selection
+      crossoverMethod: Parsed info in order to specify GA crossover during breeding
+      crossoverProb: Probability that indiviudals will crossover during breeding
+      mutationProb: Probability that a bred individual's information will be mutated
+      numOfGenerations: Number of iterations the GA will run (on each island)
+*/
+template <class Ind>
+void GeneticAlgorithm::runIslands(SelectionMethod selectionMethod,
+                                  CrossoverMethod crossoverMethod,
+                                  double crossoverProb,
+                                  double mutationProb,
+                                  int numOfGenerations)
+{
+    topFitness = 0.0;
+    topGeneration = 0;
+    topIndividual = NULL;
+    success = false;
+    stoppedByOther = false;
+    
+    // Every island needs at least two individuals to breed, and can't send more
+    // migrants than it has
+    int numIslands = std::max(1, std::min(islandSettings.numIslands, static_cast<int>(population.size()) / 2));
+    int numMigrants = std::max(0, std::min(islandSettings.numMigrants, static_cast<int>(population.size()) / numIslands));
+    int interval = std::max(1, islandSettings.interval);
+    
+    // Split the population into islands, each with its own buffers and random stream
+    std::vector<Island> islands(numIslands);
+    std::vector<Random> rngs;
+    for (int k = 0; k < numIslands; k++) {
+        Island& island = islands[k];
+        island.population.assign(population.begin() + chunkBegin(k, numIslands, population.size()),
+                                 population.begin() + chunkBegin(k + 1, numIslands, population.size()));
+        for (unsigned int i = 0; i < island.population.size(); i++)
+            island.nextGeneration.push_back(island.population[i]->clone());
+        island.spare = island.population[0]->clone();
+        island.generation = 0;
+        island.topFitness = 0.0;
+        island.topGeneration = 0;
+        for (int i = 0; shared && i < shared->getNumMigrants(); i++)
+            island.arrivals.push_back(island.population[0]->clone());
+        island.cursor = 0;
+        rngs.push_back(Random(seed, k + 1));
+    }
+    
+    // One mailbox per directed edge of the topology, the one from island "from" to
+    // island "to" being mailboxes[to * numIslands + from]
+    std::vector<std::unique_ptr<Mailbox>> mailboxes(numIslands * numIslands);
+    for (int to = 0; to < numIslands && numMigrants > 0; to++) {
+        for (int from = 0; from < numIslands; from++) {
+            if (from != to && (islandSettings.topology == MigrationTopology::full || to == (from + 1) % numIslands))
+                mailboxes[to * numIslands + from].reset(new Mailbox(*population[0], numMigrants));
+        }
+    }
+    
+    std::atomic<bool> stop(false);
+    BreedKernel<Ind> breed = breedKernel<Ind>(selectionMethod, crossoverMethod);
+    ThreadPool pool(numIslands);
+    pool.run(numIslands, [&](int k) {
+        Island& island = islands[k];
+        Random& rng = rngs[k];
+        int size = island.population.size();
+        Sampler sampler(selectionMethod, island.population, island.evaluations, temperature);
+        std::vector<Ind*> current = typedIndividuals<Ind>(island.population);
+        std::vector<Ind*> next = typedIndividuals<Ind>(island.nextGeneration);
+        Ind& spare = *static_cast<Ind*>(island.spare.get());
+        
+        while (!stop.load(std::memory_order_relaxed) && ++island.generation <= numOfGenerations) {
+            island.evaluations.assign(size, 0.0);
+            Ind::evaluateBatch(current.data(), size, island.evaluations.data());
+            
+            // Keep a copy of the island's best ever individual, and stop every island
+            // once one finds a complete solution
+            int best = std::max_element(island.evaluations.begin(), island.evaluations.end()) - island.evaluations.begin();
+            if (island.evaluations[best] > island.topFitness || !island.topIndividual) {
+                island.topFitness = island.evaluations[best];
+                if (island.topIndividual)
+                    island.topIndividual->copyFrom(*island.population[best]);
+                else
+                    island.topIndividual = island.population[best]->clone();
+                island.topGeneration = island.generation;
+            }
+            if (island.topFitness == maxSolution) {
+                if (shared) {
+                    shared->offerBest(*island.topIndividual, island.topFitness);
+                    shared->requestStop();
+                }
+                stop.store(true, std::memory_order_relaxed);
+                break;
+            }
+            
+            // Every island trades with the other processes on its own
+            if (shared) {
+                if (shared->stopRequested())
+                    break;
+                if (island.generation % shared->getInterval() == 0) {
+                    shared->offerBest(*island.topIndividual, island.topFitness);
+                    exchangeShared(island.population, island.evaluations, island.order, island.arrivals, island.cursor);
+                }
+            }
+            
+            if (island.generation % interval == 0 && numMigrants > 0) {
+                rankPopulation(island.evaluations, island.order);
+                
+                // Send copies of the best individuals to every neighbour
+                for (int to = 0; to < numIslands; to++) {
+                    Mailbox* mailbox = mailboxes[to * numIslands + k].get();
+                    if (!mailbox) continue;
+                    for (int i = 0; i < numMigrants; i++)
+                        mailbox->outgoing()[i]->copyFrom(*island.population[island.order[i]]);
+                    mailbox->send(numMigrants);
+                }
+                
+                // Replace the worst individuals (at most half the island) with the
+                // migrants that have arrived. Migrants carry their fitness with them
+                int replaced = 0;
+                for (int from = 0; from < numIslands; from++) {
+                    Mailbox* mailbox = mailboxes[k * numIslands + from].get();
+                    if (!mailbox || !mailbox->receive()) continue;
+                    for (int i = 0; i < mailbox->incomingCount() && replaced < size / 2; i++) {
+                        int worst = island.order[size - 1 - replaced++];
+                        island.population[worst]->copyFrom(*mailbox->incoming()[i]);
+                        island.evaluations[worst] = island.population[worst]->evaluateFitness();
+                    }
+                }
+            }
+            
+            sampler.update();
+            breed(current.data(), next.data(), 0, size, spare,
+                  sampler, crossoverProb, mutationMethod, mutationProb,
+                  localSearch, rng);
+            island.population.swap(island.nextGeneration);
+            current.swap(next);
+            
+            if (k == 0)
+                std::cout << "Generation: " << island.generation << std::endl;
+        }
+    });
+    
+    // Report the best individual of any island, and gather the islands back into
+    // one final population
+    int winner = 0;
+    for (int k = 1; k < numIslands; k++) {
+        if (islands[k].topFitness > islands[winner].topFitness)
+            winner = k;
+    }
+    topFitness = islands[winner].topFitness;
+    topGeneration = islands[winner].topGeneration;
+    topIndividual = islands[winner].topIndividual;
+    currentGeneration = std::min(islands[winner].generation, numOfGenerations);
+    
+    population.clear();
+    for (int k = 0; k < numIslands; k++)
+        population.insert(population.end(), islands[k].population.begin(), islands[k].population.end());
+    
+    if (topIndividual && topFitness == maxSolution) {
+        success = true;
+        printSuccess();
+    } else {
+        stoppedByOther = shared && shared->stopRequested();
+        printEnd();
+    }
+}
+
+// The run loops are compiled for plain Individuals and for MAXSAT individuals
+template void GeneticAlgorithm::runAs<Individual>(SelectionMethod, CrossoverMethod, double, double, int);
+template void GeneticAlgorithm::runAs<MAXSATIndividual>(SelectionMethod, CrossoverMethod, double, double, int);
+
+/*
+ Orders a population from best to worst, breaking ties by index so the order does not
+ depend on the sort
+ Parameters:
+      evaluations: The fitness of each individual
+      order: Output, the indices of the individuals from best to worst
+*/
+void GeneticAlgorithm::rankPopulation(const std::vector<double>& evaluations, std::vector<int>& order)
+{
+    order.resize(evaluations.size());
+    for (unsigned int i = 0; i < order.size(); i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&evaluations](int a, int b) {
+        return evaluations[a] > evaluations[b] || (evaluations[a] == evaluations[b] && a < b);
+    });
+}
+
+/*
+ Publishes copies of the best individuals of a population to the other processes
+ sharing the run, and replaces the worst individuals (at most half the population)
+ with migrants the other processes have published since the last exchange
+ Parameters:
+      pop: The population (or island) to trade from
+      evals: The fitness of each individual of pop, updated for the migrants
+      order: Scratch space to rank pop in
+      arrivals: Individuals to read migrants into
+      cursor: The newest migrant read from the shared segment so far, updated
+*/
+void GeneticAlgorithm::exchangeShared(std::vector<std::shared_ptr<Individual>>& pop, std::vector<double>& evals,
+                                      std::vector<int>& order, std::vector<std::shared_ptr<Individual>>& arrivals,
+                                      uint64_t& cursor) const
+{
+    int size = pop.size();
+    rankPopulation(evals, order);
+    int count = std::min(static_cast<int>(arrivals.size()), size);
+    for (int i = 0; i < count; i++)
+        shared->publish(*pop[order[i]], evals[order[i]]);
+    
+    int arrived = shared->collect(arrivals, std::min(count, size / 2), cursor);
+    for (int i = 0; i < arrived; i++) {
+        int worst = order[size - 1 - i];
+        pop[worst]->copyFrom(*arrivals[i]);
+        evals[worst] = pop[worst]->evaluateFitness();
+    }
+}
+
 /*
  Finds the "best" (the highest fitness) individual in the current population
  Returns the index of the that best individual (for both eval and pop vectors)
@@ -169,15 +499,13 @@ int GeneticAlgorithm::getBestIndividual() const
 */
 void GeneticAlgorithm::printSuccess() const
 {
+    const CNF& reported = preprocessor ? preprocessor->getOriginal() : problem;
     std::cout << std::endl
-              << "For file: " << filepath << std::endl
-              << "With " << numVars << " variables and " << maxSolution << " clauses" << std::endl
-              << "Complete solution found in generation: " << currentGeneration << std::endl
-              << topFitness << " out of " << maxSolution << " clauses satisfied: "
-                            << topFitness/maxSolution * 100 << "%" << std::endl
-              << "Assignment: " << std::endl;
-
-    topIndividual->print();
+              << "For file: " << reported.getFilepath() << std::endl
+              << "With " << reported.getNumVars() << " variables and " << reported.getNumClauses() << " clauses" << std::endl
+              << "Complete solution found in generation: " << currentGeneration << std::endl;
+    
+    printSolution();
 }
 
 /*
@@ -187,23 +515,67 @@ void GeneticAlgorithm::printSuccess() const
 */
 void GeneticAlgorithm::printEnd() const
 {
+    const CNF& reported = preprocessor ? preprocessor->getOriginal() : problem;
     std::cout << std::endl
-              << "Generations Complete." << std::endl
-              << "For file: " << filepath << std::endl
-              << "With " << numVars << " variables and " << maxSolution << " clauses" << std::endl
-              << "Best solution found in generation: " << topGeneration << std::endl
-              << topFitness << " out of " << maxSolution << " clauses satisfied: "
-                            << topFitness/maxSolution * 100 << "%" << std::endl
+              << (stoppedByOther ? shared->stopReason() : "Generations Complete.") << std::endl
+              << "For file: " << reported.getFilepath() << std::endl
+              << "With " << reported.getNumVars() << " variables and " << reported.getNumClauses() << " clauses" << std::endl
+              << "Best solution found in generation: " << topGeneration << std::endl;
+    
+    printSolution();
+}
+
+/*
+ Prints how many clauses the best individual found satisfies, and its assignment. If the
+ problem was preprocessed, both are given in terms of the original problem
+*/
+void GeneticAlgorithm::printSolution() const
+{
+    double fitness = topFitness;
+    double clauses = maxSolution;
+    if (preprocessor && topIndividual) {
+        fitness = preprocessor->originalFitness(*topIndividual);
+        clauses = preprocessor->getOriginal().getNumClauses();
+    }
+    std::cout << fitness << " out of " << clauses << " clauses satisfied: "
+              << fitness/clauses * 100 << "%" << std::endl
               << "Assignment: " << std::endl;
     
     // Only print the individual if there is one, avoids segfaults on 0 generations
-    if (topIndividual)
-        topIndividual->print();
-    else
+    if (!topIndividual)
         std::cout << "No assignment found." << std:: endl;
+    else if (preprocessor)
+        preprocessor->print(*topIndividual);
+    else
+        topIndividual->print();
 }
 
 
+/*
+ Splits the command line into positional arguments and "--name value" options
+ Parameters:
+        argc, argv: The command line passed to main
+        options: Map to store the options in, keyed by name (without the dashes)
+ Returns the positional arguments (including the program name), or an empty vector
+ if an option is missing its value
+*/
+static std::vector<std::string> parseCommandLine(int argc, char** argv,
+                                                 std::map<std::string, std::string>& options)
+{
+    std::vector<std::string> args;
+    for (int i = 0; i < argc; i++) {
+        std::string arg(argv[i]);
+        if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            if (i + 1 >= argc)
+                return std::vector<std::string>();
+            options[arg.substr(2)] = argv[++i];
+        } else {
+            args.push_back(arg);
+        }
+    }
+    return args;
+}
+
 /*                     
  The main function, which reads in arguments from the command line to specify running either
  a genetic algorithm or population based incremental learning algorithm, here implemented for
@@ -212,32 +584,106 @@ void GeneticAlgorithm::printEnd() const
 int main(int argc, char** argv)
 {
     // Check commandline arguments
-    if (argc != 9) {
+    std::map<std::string, std::string> options;
+    std::vector<std::string> args = parseCommandLine(argc, argv, options);
+    if (args.size() != 9) {
         std::cout << "USAGE GA: filename populationSize selectionMethod crossoverMethod crossoverProb mutationProb numGenerations g"
                   << std::endl << "USAGE PBIL: filename generationSize positiveLearningRate negativeLearningRate mutationProbability mutationShift numIterations p"
+                  << std::endl << "OPTIONS: --threads N, --seed S, --temperature T (GA only), --mutation uniform|focused (GA only), --preprocess none|maxsat|sat, --fitness-cache N"
+                  << std::endl << "ISLAND OPTIONS (GA only): --islands K, --migration-interval M, --migrants N, --topology ring|full"
+                  << std::endl << "PBIL OPTIONS: --batch B, --learn K, --precision double|float|fixed"
+                  << std::endl << "LOCAL SEARCH OPTIONS: --local-search none|walksat|gsat, --flips N, --noise P"
+                  << std::endl << "SHARED OPTIONS: --shared NAME, --shared-interval M, --shared-migrants N"
                   << std::endl;
         return -1;
     }
+    
+    int numThreads = options.count("threads") ? atoi(options["threads"].c_str()) : 1;
+    uint64_t seed = options.count("seed") ? std::stoull(options["seed"]) : time(NULL);
+    double temperature = options.count("temperature") ? std::stod(options["temperature"]) : 1.0;
+    if (temperature <= 0.0) {
+        std::cout << "USAGE temperature must be positive" << std::endl;
+        return -1;
+    }
+
+    // Parse how much to simplify the problem before running
+    PreprocessLevel preprocessLevel = PreprocessLevel::none;
+    if (options.count("preprocess")) {
+        if (options["preprocess"] == "none")
+            preprocessLevel = PreprocessLevel::none;
+        else if (options["preprocess"] == "maxsat")
+            preprocessLevel = PreprocessLevel::maxsat;
+        else if (options["preprocess"] == "sat")
+            preprocessLevel = PreprocessLevel::sat;
+        else {
+            std::cout << "USAGE invalid preprocessing level" << std::endl;
+            return -1;
+        }
+    }
 
-    // Read in problem
-    int numVars = readClauses(argv[1]);
+    // Read in problem, and simplify it if asked to. The algorithms run on the
+    // simplified problem and report results in terms of the original
+    CNF original;
+    readClauses(args[1], original, numThreads);
+    CNF simplified;
+    std::unique_ptr<Preprocessor> preprocessor;
+    if (preprocessLevel != PreprocessLevel::none) {
+        preprocessor.reset(new Preprocessor(original, simplified, preprocessLevel));
+        preprocessor->printSummary();
+    }
+    const CNF& problem = preprocessor ? simplified : original;
+    
+    // Parse how (and whether) to improve individuals by local search
+    LocalSearchSettings localSearch;
+    if (options.count("local-search")) {
+        if (options["local-search"] == "none")
+            localSearch.method = LocalSearchMethod::none;
+        else if (options["local-search"] == "walksat")
+            localSearch.method = LocalSearchMethod::walkSAT;
+        else if (options["local-search"] == "gsat")
+            localSearch.method = LocalSearchMethod::gsat;
+        else {
+            std::cout << "USAGE invalid local search method" << std::endl;
+            return -1;
+        }
+    }
+    if (options.count("flips"))
+        localSearch.maxFlips = atoi(options["flips"].c_str());
+    if (options.count("noise"))
+        localSearch.noise = std::stod(options["noise"]);
+    
+    // Make the cache of recently scored genomes, if asked for one
+    std::unique_ptr<FitnessCache> fitnessCache;
+    if (options.count("fitness-cache") && atoi(options["fitness-cache"].c_str()) > 0)
+        fitnessCache.reset(new FitnessCache(atoi(options["fitness-cache"].c_str())));
     
     // Seed random number generator
-    // NOTE Done here since it must be done before building initial population
-    //      but cannot be done more than once
-    srand(time(NULL));
+    // NOTE Done here since it must be done before building initial population.
+    //      The algorithms split further streams off the same seed
+    Random rng(seed);
+    
+    // Attach to the segment shared with other processes solving the same problem, if
+    // asked to cooperate with them
+    std::unique_ptr<SharedMigration> shared;
+    if (options.count("shared")) {
+        MAXSATIndividual prototype(problem, rng);
+        shared.reset(new SharedMigration(options["shared"], problem, prototype,
+                                         options.count("shared-interval") ? atoi(options["shared-interval"].c_str()) : 10,
+                                         options.count("shared-migrants") ? atoi(options["shared-migrants"].c_str()) : 2));
+    }
     
-    // Time how long it takes to run algorithm
-    std::clock_t start = clock();
+    // Time how long it takes to run algorithm, in wall clock time so that
+    // threaded runs are not charged for every thread's CPU time
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-    std::string algorithmInput(argv[8]);
+    std::string algorithmInput(args[8]);
     
     // Get ready to run the genetic algorithm by parsing the string
     // parameters and calling the GA constructor
     if (algorithmInput == "g") {
         
         // Parse selection method
-        std::string selectionInput(argv[3]);
+        std::string selectionInput(args[3]);
         SelectionMethod selectionMethod; 
         if (selectionInput == "r")
             selectionMethod = SelectionMethod::ranking;
@@ -251,7 +697,7 @@ int main(int argc, char** argv)
         }
 
         // Parse crossover method
-        std::string crossoverInput(argv[4]);
+        std::string crossoverInput(args[4]);
         CrossoverMethod crossoverMethod; 
         if (crossoverInput == "o")
             crossoverMethod = CrossoverMethod::onePoint;
@@ -262,18 +708,54 @@ int main(int argc, char** argv)
             return -1;
         }
 
+        // Parse mutation method
+        MutationMethod mutationMethod = MutationMethod::uniform;
+        if (options.count("mutation")) {
+            if (options["mutation"] == "uniform")
+                mutationMethod = MutationMethod::uniform;
+            else if (options["mutation"] == "focused")
+                mutationMethod = MutationMethod::focused;
+            else {
+                std::cout << "USAGE invalid mutation method" << std::endl;
+                return -1;
+            }
+        }
+
+        // Parse the island model settings
+        IslandSettings islandSettings;
+        if (options.count("islands"))
+            islandSettings.numIslands = atoi(options["islands"].c_str());
+        if (options.count("migration-interval"))
+            islandSettings.interval = atoi(options["migration-interval"].c_str());
+        if (options.count("migrants"))
+            islandSettings.numMigrants = atoi(options["migrants"].c_str());
+        if (options.count("topology")) {
+            if (options["topology"] == "ring")
+                islandSettings.topology = MigrationTopology::ring;
+            else if (options["topology"] == "full")
+                islandSettings.topology = MigrationTopology::full;
+            else {
+                std::cout << "USAGE invalid migration topology" << std::endl;
+                return -1;
+            }
+        }
+
         // Build initial population so the GA algorithm can run
         // on a generic population
         std::vector<std::shared_ptr<Individual>> initialPopulation;
-        for (int i = 0; i < atoi(argv[2]); i++) {
-            initialPopulation.push_back(std::shared_ptr<Individual>(new MAXSATIndividual(numVars)));
+        for (int i = 0; i < atoi(args[2].c_str()); i++) {
+            MAXSATIndividual* individual = new MAXSATIndividual(problem, rng);
+            individual->setFitnessCache(fitnessCache.get());
+            initialPopulation.push_back(std::shared_ptr<Individual>(individual));
         }
 
-        // Run genetic algorithm
+        // Run genetic algorithm, breeding with the kernels compiled for MAXSAT individuals
         GeneticAlgorithm ga(initialPopulation, selectionMethod,
-                            crossoverMethod, std::stod(std::string(argv[5])), 
-                            std::stod(std::string(argv[6])), atoi(argv[7]),
-                            clauses.size(), numVars);
+                            crossoverMethod, std::stod(args[5]), 
+                            std::stod(args[6]), atoi(args[7].c_str()),
+                            problem.getNumClauses(), problem,
+                            numThreads, seed, temperature, preprocessor.get(), islandSettings, shared.get(), localSearch,
+                            mutationMethod, GeneticAlgorithm::engine<MAXSATIndividual>());
     }
     
     // Get ready to run the PBIL algorithm by constructing a sample individual
@@ -282,12 +764,36 @@ int main(int argc, char** argv)
         
         // Generate a sample individual of the desired type so the PBIL can
         // generically generate new individuals from that sample type
-        std::shared_ptr<Individual> sample(new MAXSATIndividual(numVars));
+        MAXSATIndividual* sampleIndividual = new MAXSATIndividual(problem, rng);
+        sampleIndividual->setFitnessCache(fitnessCache.get());
+        std::shared_ptr<Individual> sample(sampleIndividual);
+
+        // Parse how many individuals each thread samples at a time (0 for all of them),
+        // and how many of the best and worst individuals to learn from
+        int batchSize = options.count("batch") ? atoi(options["batch"].c_str()) : 0;
+        int learnSize = options.count("learn") ? atoi(options["learn"].c_str()) : 1;
+        
+        // Parse the number format to learn the probabilities in
+        ProbabilityPrecision precision = ProbabilityPrecision::double64;
+        if (options.count("precision")) {
+            if (options["precision"] == "double")
+                precision = ProbabilityPrecision::double64;
+            else if (options["precision"] == "float")
+                precision = ProbabilityPrecision::float32;
+            else if (options["precision"] == "fixed")
+                precision = ProbabilityPrecision::fixed32;
+            else {
+                std::cout << "USAGE invalid probability precision" << std::endl;
+                return -1;
+            }
+        }
 
         // Run PBIL
-        PBIL pbil(numVars, sample, atof(argv[2]),
-                  atof(argv[3]), atof(argv[4]), atof(argv[5]),
-                  atof(argv[6]), atoi(argv[7]), clauses.size());
+        PBIL pbil(problem.getNumVars(), sample, atof(args[2].c_str()),
+                  atof(args[3].c_str()), atof(args[4].c_str()), atof(args[5].c_str()),
+                  atof(args[6].c_str()), atoi(args[7].c_str()), problem.getNumClauses(), problem,
+                  numThreads, batchSize, learnSize, seed, preprocessor.get(), shared.get(), localSearch,
+                  precision, PBIL::engine<MAXSATIndividual>());
     }
       
     // Report no appropriate algorithm selection (g or p)
@@ -296,12 +802,31 @@ int main(int argc, char** argv)
         return -1;
     }
     
-    // Calculate and output elapsed time
-    std::clock_t end = clock();
-    double timeInSeconds = (end - start) / (double) CLOCKS_PER_SEC;
-    std::cout << "Time elapsed: " << timeInSeconds << " seconds" << std::endl;
+    // Report the best individual any cooperating process has found so far
+    if (shared) {
+        MAXSATIndividual best(problem, rng);
+        if (shared->readBest(best)) {
+            double fitness = preprocessor ? preprocessor->originalFitness(best) : best.evaluateFitness();
+            double clauses = preprocessor ? preprocessor->getOriginal().getNumClauses() : problem.getNumClauses();
+            std::cout << "Best of all processes sharing " << options["shared"] << ": " << fitness << " out of "
+                      << clauses << " clauses satisfied" << std::endl;
+        }
+    }
+    
+    // Report how many scorings the fitness cache saved
+    if (fitnessCache) {
+        uint64_t lookups = fitnessCache->getLookups();
+        uint64_t hits = fitnessCache->getHits();
+        std::cout << "Fitness cache: " << hits << " hits out of " << lookups << " lookups ("
+                  << (lookups ? 100.0 * hits / lookups : 0.0) << "%)" << std::endl;
+    }
+    
+    // Calculate and output elapsed time, and the seed needed to replay the run
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    double timeInSeconds = std::chrono::duration<double>(end - start).count();
+    std::cout << "Time elapsed: " << timeInSeconds << " seconds" << std::endl
+              << "Seed: " << seed << std::endl;
     
     // Return OK status and close program
     return 0;
 }
-  
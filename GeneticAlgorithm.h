@@ -2,6 +2,11 @@
 
 #include "Individual.h"
 #include "Sampler.h"
+#include "ThreadPool.h"
+#include "Random.h"
+#include "Preprocessor.h"
+#include "Mailbox.h"
+#include "SharedMigration.h"
 
 #include <memory>
 #include <stdio.h>
@@ -23,9 +28,38 @@
  
 */
 
+enum class MigrationTopology { ring, full };
+
+// Settings for running the GA as an island model: the population is split into
+// numIslands sub-populations, each evolved by its own thread, and every interval
+// generations each island sends copies of its best numMigrants individuals to its
+// neighbours in the topology (the next island for ring, every island for full).
+// With one island the GA evolves a single population.
+struct IslandSettings {
+    int numIslands;
+    int interval;
+    int numMigrants;
+    MigrationTopology topology;
+    
+    IslandSettings() : numIslands(1), interval(10), numMigrants(2), topology(MigrationTopology::ring) {}
+};
+
 // The abstract GA, written to evolve generations of Individuals.
+// The run loops are compiled for one type of individual (see runAs), and hold the
+// population by that type, so that evaluation and breeding call its methods directly.
+// Breeding, which runs once per offspring, is further done by a kernel compiled for
+// one selection and crossover method (see breedRange), so that the compiler can
+// inline the selection and the genome operations into the loop. The loops for plain
+// Individuals work for any subclass through its virtual methods.
 class GeneticAlgorithm {
 public:
+    // The run loops compiled for a type of individual
+    typedef void (GeneticAlgorithm::*Engine)(SelectionMethod selectionMethod, CrossoverMethod crossoverMethod,
+                                             double crossoverProb, double mutationProb, int numOfGenerations);
+    
+    template <class Ind>
+    static Engine engine() { return &GeneticAlgorithm::runAs<Ind>; }
+    
     GeneticAlgorithm(std::vector<std::shared_ptr<Individual>> initialPopulation,
                      SelectionMethod selectionMethod, 
                      CrossoverMethod crossoverMethod,
@@ -33,31 +67,138 @@ public:
                      double mutationProb,
                      int numOfGenerations,
                      double maxSolution_,
-                     int numVars_);
+                     const CNF& problem_,
+                     int numThreads_ = 1,
+                     uint64_t seed_ = 0,
+                     double temperature_ = 1.0,
+                     const Preprocessor* preprocessor_ = NULL,
+                     const IslandSettings& islandSettings_ = IslandSettings(),
+                     SharedMigration* shared_ = NULL,
+                     const LocalSearchSettings& localSearch_ = LocalSearchSettings(),
+                     MutationMethod mutationMethod_ = MutationMethod::uniform,
+                     Engine engine_ = NULL);
     
     std::vector<std::shared_ptr<Individual>>& getFinalPopulation() { return population; }
 
 private:
+    template <class Ind>
+    void runAs(SelectionMethod selectionMethod,
+               CrossoverMethod crossoverMethod,
+               double crossoverProb,
+               double mutationProb,
+               int numOfGenerations);
+    template <class Ind>
     void run(SelectionMethod selectionMethod, 
              CrossoverMethod crossoverMethod,
              double crossoverProb,
              double mutationProb,
              int numOfGenerations);
+    template <class Ind>
+    void runIslands(SelectionMethod selectionMethod,
+                    CrossoverMethod crossoverMethod,
+                    double crossoverProb,
+                    double mutationProb,
+                    int numOfGenerations);
+    
+    // A breeding kernel: breedRange compiled for a type of individual and a selection
+    // and crossover method
+    template <class Ind>
+    using BreedKernel = void (*)(Ind* const* parents, Ind* const* children,
+                                 int begin, int end, Ind& spare, const Sampler& sampler,
+                                 double crossoverProb, MutationMethod mutationMethod, double mutationProb,
+                                 const LocalSearchSettings& localSearch, Random& rng);
+    
+    template <class Ind>
+    static BreedKernel<Ind> breedKernel(SelectionMethod selectionMethod, CrossoverMethod crossoverMethod);
+    
+    template <class Ind, SelectionMethod selectionMethod, CrossoverMethod crossoverMethod>
+    static void breedRange(Ind* const* parents, Ind* const* children,
+                           int begin, int end, Ind& spare, const Sampler& sampler,
+                           double crossoverProb, MutationMethod mutationMethod, double mutationProb,
+                           const LocalSearchSettings& localSearch, Random& rng);
+    
+    // Crossover with a fixed method, through the virtual interface in general and
+    // directly for MAXSAT individuals
+    template <CrossoverMethod crossoverMethod>
+    static void crossover(const Individual& parent1, const Individual& parent2, Random& rng,
+                          Individual& child1, Individual& child2)
+        { parent1.breedInto(crossoverMethod, parent2, rng, child1, child2); }
+    template <CrossoverMethod crossoverMethod>
+    static void crossover(const MAXSATIndividual& parent1, const MAXSATIndividual& parent2, Random& rng,
+                          MAXSATIndividual& child1, MAXSATIndividual& child2)
+        { parent1.breedInto<crossoverMethod>(parent2, rng, child1, child2); }
+    
+    static void rankPopulation(const std::vector<double>& evaluations, std::vector<int>& order);
+    void exchangeShared(std::vector<std::shared_ptr<Individual>>& pop, std::vector<double>& evals,
+                        std::vector<int>& order, std::vector<std::shared_ptr<Individual>>& arrivals,
+                        uint64_t& cursor) const;
     
     int getBestIndividual() const;
+    
+    static int chunkBegin(int chunk, int numChunks, int size)
+        { return static_cast<int>(static_cast<long long>(size) * chunk / numChunks); }
 
     void printSuccess() const;
     void printEnd() const;
+    void printSolution() const;
     
     int currentGeneration;
 
     // Vectors to store the abstract individuals and the evaluations
-    // of those individuals
+    // of those individuals, plus the buffer the next generation is bred into
     std::vector<std::shared_ptr<Individual>> population;
+    std::vector<std::shared_ptr<Individual>> nextGeneration;
     std::vector<double> evaluations;
     
     double maxSolution;
-    int numVars;
+    
+    // The problem being solved, used only when printing results, and how it was
+    // simplified from the original problem (if it was)
+    const CNF& problem;
+    const Preprocessor* preprocessor;
+    
+    // Number of threads to evaluate and breed with, each with its own
+    // random stream derived from the seed
+    int numThreads;
+    uint64_t seed;
+    
+    // Temperature for boltzmann selection
+    double temperature;
+    
+    // How the population is split into islands, if it is, and the segment shared with
+    // other processes working on the same problem (NULL if there are none)
+    IslandSettings islandSettings;
+    SharedMigration* shared;
+    
+    // How offspring are mutated, and improved by local search before they are
+    // evaluated (if they are)
+    MutationMethod mutationMethod;
+    LocalSearchSettings localSearch;
+    
+    // The run loops for the type of the individuals
+    Engine runLoops;
+    
+    // One sub-population of an island model run, with the buffers it is bred
+    // through and the best individual it has found
+    struct Island {
+        std::vector<std::shared_ptr<Individual>> population;
+        std::vector<std::shared_ptr<Individual>> nextGeneration;
+        std::vector<double> evaluations;
+        std::shared_ptr<Individual> spare;
+        
+        // Indices of the population from best to worst, found when migrating
+        std::vector<int> order;
+        
+        // Individuals to read migrants from other processes into, and the newest
+        // migrant read so far
+        std::vector<std::shared_ptr<Individual>> arrivals;
+        uint64_t cursor;
+        
+        int generation;
+        double topFitness;
+        int topGeneration;
+        std::shared_ptr<Individual> topIndividual;
+    };
     
     int bestFitIndex;
     
@@ -68,4 +209,80 @@ private:
     std::shared_ptr<Individual> topIndividual;
     
     bool success;
+    bool stoppedByOther;
 };
+
+/*
+ Fills part of the next generation with offspring bred from the current one. The
+ individuals are held by their type Ind, and the selection and crossover methods are
+ fixed, so that with Ind a final class like MAXSATIndividual the compiler calls
+ everything directly and inlines the selection
+ Parameters:
+      parents: The current generation
+      children: The next generation, whose individuals are overwritten
+      begin, end: The range of children to fill
+      spare: Individual to hold the second offspring of a crossover when there is no
+          room left in the range (it is then discarded)
+      sampler: Sampler selecting parents from the current generation with selectionMethod
+      crossoverProb: Probability that individuals will crossover during breeding
+      mutationMethod: How to pick the bits a bred individual mutates
+      mutationProb: Probability that a bred individual's information will be mutated
+      localSearch: How to improve each offspring by local search once it is mutated
+      rng: Random stream to draw from
+*/
+template <class Ind, SelectionMethod selectionMethod, CrossoverMethod crossoverMethod>
+void GeneticAlgorithm::breedRange(Ind* const* parents, Ind* const* children,
+                                  int begin, int end, Ind& spare, const Sampler& sampler,
+                                  double crossoverProb, MutationMethod mutationMethod, double mutationProb,
+                                  const LocalSearchSettings& localSearch, Random& rng)
+{
+    int next = begin;
+    while (next < end) {
+        Ind& first = *children[next++];
+
+        // With probability crossoverProb, breed two Individuals (the second
+        // one goes to the spare if there is no room left in the range)
+        if (rng.nextDouble() < crossoverProb) {
+            Ind& second = next < end ? *children[next++] : spare;
+            const Ind& parent1 = *parents[sampler.select<selectionMethod>(rng)];
+            const Ind& parent2 = *parents[sampler.select<selectionMethod>(rng)];
+            crossover<crossoverMethod>(parent1, parent2, rng, first, second);
+            
+            if (&second != &spare) {
+                second.mutate(mutationMethod, mutationProb, rng);
+                second.localSearch(localSearch, rng);
+            }
+        } else { // Else, just take a copy of an Individual (which keeps its fitness)
+            first.copyFrom(*parents[sampler.select<selectionMethod>(rng)]);
+        }
+
+        // With probability mutationProb, mutate the Individual, then improve it
+        first.mutate(mutationMethod, mutationProb, rng);
+        first.localSearch(localSearch, rng);
+    }
+}
+
+/*
+ Picks the breeding kernel for individuals of type Ind (see breedRange)
+ Parameters:
+      selectionMethod: How parents are selected
+      crossoverMethod: How parents are crossed over
+ Returns the kernel
+*/
+template <class Ind>
+GeneticAlgorithm::BreedKernel<Ind> GeneticAlgorithm::breedKernel(SelectionMethod selectionMethod,
+                                                                 CrossoverMethod crossoverMethod)
+{
+    if (crossoverMethod == CrossoverMethod::onePoint) {
+        if (selectionMethod == SelectionMethod::ranking)
+            return &breedRange<Ind, SelectionMethod::ranking, CrossoverMethod::onePoint>;
+        if (selectionMethod == SelectionMethod::tournament)
+            return &breedRange<Ind, SelectionMethod::tournament, CrossoverMethod::onePoint>;
+        return &breedRange<Ind, SelectionMethod::boltzmann, CrossoverMethod::onePoint>;
+    }
+    if (selectionMethod == SelectionMethod::ranking)
+        return &breedRange<Ind, SelectionMethod::ranking, CrossoverMethod::uniform>;
+    if (selectionMethod == SelectionMethod::tournament)
+        return &breedRange<Ind, SelectionMethod::tournament, CrossoverMethod::uniform>;
+    return &breedRange<Ind, SelectionMethod::boltzmann, CrossoverMethod::uniform>;
+}
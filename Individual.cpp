@@ -1,4 +1,5 @@
 #include "Individual.h"
+#include "BitSlice.h"
 
 /*
  
@@ -16,55 +17,343 @@
  
 */
 
+// How many random clauses focused mutation checks for an unsatisfied one in an
+// individual without clause counts before it falls back to a uniform flip
+static const int MAX_CLAUSE_TRIES = 64;
+
+/*
+ Default batch evaluation for Individuals, scoring each one on its own
+ Parameters:
+        population: The individuals to evaluate
+        count: How many individuals population holds
+        evaluations: Output, count entries
+*/
+void Individual::evaluatePopulation(Individual* const* population, int count, double* evaluations) const
+{
+    for (int i = 0; i < count; i++)
+        evaluations[i] = population[i]->evaluateFitness();
+}
+
 /*
  A constructor for a Maximum-Satisifiablity (MAXSAT) assignment individual,
  where bit assignments are equally random.
  Parameters:
-        size: Size of the bitstring array
+        cnf_: The problem being solved, which determines the size of the bitstring array
+        rng: Random stream to draw the assignment from
 */
-MAXSATIndividual::MAXSATIndividual(int size)
-	: data(size, 0)
+MAXSATIndividual::MAXSATIndividual(const CNF& cnf_, Random& rng)
+	: cnf(&cnf_), data(numWords(cnf_.getNumVars()), 0), numSatisfied(0), evaluated(false), countsValid(false),
+      cache(NULL), hash(0)
 {
-	for (unsigned int i = 0; i < data.size(); i++)
-		data[i] = (rand() > RAND_MAX / 2 ? 1 : 0);
+    rng.fillWords(data.data(), data.size());
+    if (!data.empty())
+        data.back() &= lastWordMask();
 }
 
 /* 
  A constructor for a MAXSAT assignment individual, where bit assignments are
  based on a probability vector for a PBIL algorithm
  Parameters:
+        cnf_: The problem being solved
         probVect: Reference to the probability vector that will determine bit assignment
+        rng: Random stream to draw the assignment from
 */
-MAXSATIndividual::MAXSATIndividual(const std::vector<double>& probVect)
-    : data(probVect.size() - 1, 0)
+MAXSATIndividual::MAXSATIndividual(const CNF& cnf_, const std::vector<double>& probVect, Random& rng)
+    : cnf(&cnf_), numSatisfied(0), evaluated(false), countsValid(false), cache(NULL), hash(0)
 {
-    for (unsigned int i = 0; i < probVect.size(); i++) {
-        data[i] = ((double)rand() / RAND_MAX < probVect[i] ? 1 : 0);
-    }
+    resamplePBIL(probVect, rng);
 }
 
 /*
  A constructor for a MAXSAT assignment individual, where bit assignments are a clone
  of a passed bitset
  Parameters:
-        data_: A bit array to be cloned in this individual
+        cnf_: The problem being solved
+        data_: A packed bit array to be cloned in this individual
 */
-MAXSATIndividual::MAXSATIndividual(std::vector<bool> data_)
-	: data(data_)
+MAXSATIndividual::MAXSATIndividual(const CNF& cnf_, std::vector<uint64_t> data_)
+	: cnf(&cnf_), data(data_), numSatisfied(0), evaluated(false), countsValid(false), cache(NULL), hash(0)
 {}
 
+/*
+ Returns the mask of the bits in the final word that hold variables
+*/
+uint64_t MAXSATIndividual::lastWordMask() const
+{
+    int used = cnf->getNumVars() & 63;
+    return used == 0 ? ~static_cast<uint64_t>(0) : (static_cast<uint64_t>(1) << used) - 1;
+}
+
+/*
+ Shares a fitness cache with the individual. Individuals cloned, copied or bred from
+ it share the cache too
+ Parameters:
+        cache_: The cache, or NULL to stop using one
+*/
+void MAXSATIndividual::setFitnessCache(FitnessCache* cache_)
+{
+    cache = cache_;
+    if (cache)
+        rehash();
+}
+
+/*
+ Recomputes the hash of the assignment from scratch
+*/
+void MAXSATIndividual::rehash()
+{
+    hash = 0;
+    for (unsigned int i = 0; i < data.size(); i++)
+        hash ^= wordHash(i, data[i]);
+}
+
+/*
+ Updates the incremental fitness state for flipping a set of bits in one word.
+ A literal is true when its variable's value differs from its negation bit, so
+ each occurrence of a flipped variable either loses or gains a true literal.
+ Parameters:
+        word: Index of the word holding the flipped bits
+        flips: Mask of the bits being flipped
+        oldWord: Value of the word before the flips are applied
+*/
+void MAXSATIndividual::flipCounts(int word, uint64_t flips, uint64_t oldWord)
+{
+    while (flips) {
+        int bit = __builtin_ctzll(flips);
+        flips &= flips - 1;
+        
+        int var = (word << 6) | bit;
+        unsigned int oldValue = (oldWord >> bit) & 1;
+        for (const unsigned int* occ = cnf->occurrenceBegin(var); occ != cnf->occurrenceEnd(var); ++occ) {
+            unsigned int clause = *occ >> 1;
+            if (oldValue != (*occ & 1)) {
+                if (--trueCounts[clause] == 0) {
+                    numSatisfied--;
+                    listUnsatisfied(clause);
+                }
+            } else {
+                if (trueCounts[clause]++ == 0) numSatisfied++;
+            }
+        }
+    }
+}
+
+/*
+ Adds a clause that has become unsatisfied to the unsatisfied list, unless it is
+ still on it from before
+*/
+void MAXSATIndividual::listUnsatisfied(unsigned int clause) const
+{
+    if (!listed[clause]) {
+        listed[clause] = 1;
+        unsatisfied.push_back(clause);
+    }
+}
+
+/*
+ Picks a variable of a random unsatisfied clause. With clause counts, the clause comes
+ from the unsatisfied list, dropping the clauses on it that turn out to be satisfied
+ (empty clauses are dropped too, but stay marked as listed so that they never return).
+ Without them, random clauses are checked until an unsatisfied one turns up, giving up
+ after MAX_CLAUSE_TRIES tries, so that an individual with few unsatisfied clauses
+ costs no more than a few dozen clause checks per flip
+ Parameters:
+        rng: Random stream to draw the clause and variable from
+ Returns the variable, or -1 if every clause is (or seems to be) satisfied
+*/
+int MAXSATIndividual::pickUnsatisfiedVar(Random& rng)
+{
+    if (!countsValid) {
+        int numClauses = cnf->getNumClauses();
+        for (int tries = 0; tries < MAX_CLAUSE_TRIES; tries++) {
+            int clause = rng.nextInt(numClauses);
+            const unsigned int* begin = cnf->clauseBegin(clause);
+            const unsigned int* end = cnf->clauseEnd(clause);
+            bool satisfied = (begin == end);
+            for (const unsigned int* lit = begin; lit != end && !satisfied; ++lit)
+                satisfied = at(CNF::literalVar(*lit)) != static_cast<int>(CNF::literalNegated(*lit));
+            if (!satisfied)
+                return CNF::literalVar(begin[rng.nextInt(end - begin)]);
+        }
+        return -1;
+    }
+    
+    while (!unsatisfied.empty()) {
+        int index = rng.nextInt(unsatisfied.size());
+        unsigned int clause = unsatisfied[index];
+        const unsigned int* begin = cnf->clauseBegin(clause);
+        int length = cnf->clauseEnd(clause) - begin;
+        if (trueCounts[clause] == 0 && length > 0)
+            return CNF::literalVar(begin[rng.nextInt(length)]);
+        
+        unsatisfied[index] = unsatisfied.back();
+        unsatisfied.pop_back();
+        if (length > 0)
+            listed[clause] = 0;
+    }
+    return -1;
+}
+
+/*
+ Counts the bits in which two equally sized packed genomes differ
+*/
+static int hammingDistance(const std::vector<uint64_t>& a, const std::vector<uint64_t>& b)
+{
+    int distance = 0;
+    for (unsigned int i = 0; i < a.size(); i++)
+        distance += __builtin_popcountll(a[i] ^ b[i]);
+    return distance;
+}
+
+/*
+ Gives a freshly bred individual the fitness state of the closer of its parents when
+ the two differ in only a few bits, rescoring just the clauses touched by those bits.
+ Otherwise the individual is left to be evaluated from scratch.
+ Parameters:
+        parent1, parent2: The individuals this one was bred from
+*/
+void MAXSATIndividual::inheritFitness(const MAXSATIndividual& parent1, const MAXSATIndividual& parent2)
+{
+    int distance1 = parent1.evaluated ? hammingDistance(data, parent1.data) : flipBudget() + 1;
+    int distance2 = parent2.evaluated ? hammingDistance(data, parent2.data) : flipBudget() + 1;
+    const MAXSATIndividual& parent = (distance1 <= distance2 ? parent1 : parent2);
+    int distance = std::min(distance1, distance2);
+    if (distance > flipBudget()) return;
+    
+    // An exact copy of a parent has the parent's fitness, even if the parent
+    // was scored in a batch and has no clause counts
+    if (distance == 0 && !parent.countsValid) {
+        numSatisfied = parent.numSatisfied;
+        evaluated = true;
+        return;
+    }
+    if (!parent.countsValid) return;
+    
+    trueCounts = parent.trueCounts;
+    unsatisfied = parent.unsatisfied;
+    listed = parent.listed;
+    numSatisfied = parent.numSatisfied;
+    for (unsigned int i = 0; i < data.size(); i++) {
+        if (data[i] != parent.data[i])
+            flipCounts(i, data[i] ^ parent.data[i], parent.data[i]);
+    }
+    evaluated = true;
+    countsValid = true;
+}
+
 /* 
  Mutates the MAXSAT individual for a genetic algorithm, flipping the bit
- value at an index with certain probability
+ value at an index with certain probability (see the overload below)
  Parameters:
         mutationProb: Probability that the bit at an index will be flipped
+        rng: Random stream to draw the flips from
 */
-void MAXSATIndividual::mutate(double mutationProb)
+void MAXSATIndividual::mutate(double mutationProb, Random& rng)
 {
-    for (unsigned int i = 0; i < data.size(); i++) {
-        if (static_cast<double>(rand()) / RAND_MAX < mutationProb) { 
-            data[i] = !data[i];
+    static thread_local std::vector<int> flipped;
+    mutate(mutationProb, rng, flipped);
+}
+
+/* 
+ Mutates the MAXSAT individual, flipping the bit value at an index with certain
+ probability. The flipped indices are sampled by skipping ahead geometrically (see
+ Random::sampleSparse), so the cost is proportional to the number of flips rather
+ than the number of variables. If the individual has clause counts, the clauses
+ touched by the flipped bits are rescored, unless so many bits flip that a full
+ rescore is cheaper. The hash, if kept, changes by the flipped words only.
+ Parameters:
+        mutationProb: Probability that the bit at an index will be flipped
+        rng: Random stream to draw the flips from
+        flipped: Output, the indices of the flipped bits in increasing order
+*/
+void MAXSATIndividual::mutate(double mutationProb, Random& rng, std::vector<int>& flipped)
+{
+    rng.sampleSparse(cnf->getNumVars(), mutationProb, flipped);
+    if (flipped.empty())
+        return;
+    
+    if (!countsValid || static_cast<int>(flipped.size()) > flipBudget())
+        countsValid = evaluated = false;
+    
+    for (unsigned int i = 0; i < flipped.size(); i++) {
+        int word = flipped[i] >> 6;
+        uint64_t flip = static_cast<uint64_t>(1) << (flipped[i] & 63);
+        if (countsValid)
+            flipCounts(word, flip, data[word]);
+        if (cache)
+            hash ^= wordHash(word, data[word]) ^ wordHash(word, data[word] ^ flip);
+        data[word] ^= flip;
+    }
+}
+
+/*
+ Mutates the MAXSAT individual with the given method. Uniform mutation flips random bits
+ (see above). Focused mutation makes as many flips as uniform mutation would, but flips
+ only variables of clauses that are unsatisfied at the time of the flip, so that every
+ flip satisfies at least one clause. An individual with clause counts keeps them and its
+ unsatisfied list up to date through the flips, and stays scored; one without them
+ finds unsatisfied clauses by sampling (see pickUnsatisfiedVar), makes its remaining
+ flips uniformly once sampling finds none, and is left to be scored in a batch like
+ any other mutated individual. Rebuilding its counts instead would cost a full scoring
+ from scratch, several times what the batch costs per individual
+ Parameters:
+        method: How to pick the bits to flip
+        mutationProb: Probability that the bit at an index will be flipped
+        rng: Random stream to draw the flips from
+*/
+void MAXSATIndividual::mutate(MutationMethod method, double mutationProb, Random& rng)
+{
+    static thread_local std::vector<int> flipped;
+    if (method == MutationMethod::uniform) {
+        mutate(mutationProb, rng, flipped);
+        return;
+    }
+    
+    // Draw the number of flips the same way as uniform mutation
+    rng.sampleSparse(cnf->getNumVars(), mutationProb, flipped);
+    if (flipped.empty())
+        return;
+    
+    if (!countsValid)
+        evaluated = false;
+    bool sampling = true;
+    for (unsigned int i = 0; i < flipped.size(); i++) {
+        int var = sampling ? pickUnsatisfiedVar(rng) : -1;
+        if (var < 0 && countsValid)
+            break;
+        if (var < 0) {
+            sampling = false;
+            var = flipped[i];
         }
+        int word = var >> 6;
+        uint64_t flip = static_cast<uint64_t>(1) << (var & 63);
+        if (countsValid)
+            flipCounts(word, flip, data[word]);
+        if (cache)
+            hash ^= wordHash(word, data[word]) ^ wordHash(word, data[word] ^ flip);
+        data[word] ^= flip;
+    }
+}
+
+/*
+ Improves the assignment with a bounded WalkSAT or GSAT search, which leaves the
+ individual scored
+ Parameters:
+        settings: The search method and how many flips it may make
+        rng: Random stream to draw the search's choices from
+*/
+void MAXSATIndividual::localSearch(const LocalSearchSettings& settings, Random& rng)
+{
+    if (settings.method == LocalSearchMethod::none || settings.maxFlips <= 0)
+        return;
+    
+    static thread_local LocalSearch search;
+    numSatisfied = search.run(*cnf, data.data(), settings, rng);
+    evaluated = true;
+    countsValid = false;
+    if (cache) {
+        rehash();
+        cache->store(hash, numSatisfied);
     }
 }
 
@@ -73,72 +362,296 @@ void MAXSATIndividual::mutate(double mutationProb)
  Parameters:
         method: Parsed info that determines how the indiviudals will crossover
         mate: Reference to an second individual that will be crossed with
+        rng: Random stream to draw the crossover point or mask from
  Returns the pair of pointers to the crossed offspring
 */
 std::pair<std::shared_ptr<Individual>, std::shared_ptr<Individual>>
-MAXSATIndividual::breed(CrossoverMethod method, const Individual& mate) const
+MAXSATIndividual::breed(CrossoverMethod method, const Individual& mate, Random& rng) const
 {
-    // Construct an individual with the given mate
-    const MAXSATIndividual& satMate = dynamic_cast<const MAXSATIndividual&>(mate);
+    std::shared_ptr<Individual> bred1Pt(new MAXSATIndividual(*cnf, data));
+    std::shared_ptr<Individual> bred2Pt(new MAXSATIndividual(*cnf, data));
+    breedInto(method, mate, rng, *bred1Pt, *bred2Pt);
+    return std::pair<std::shared_ptr<Individual>, std::shared_ptr<Individual>>(bred1Pt, bred2Pt);
+}
+
+/*
+ Breeds the MAXSAT individual and a given mate, writing the pair of crossed-over
+ offspring into two existing individuals, whose storage is reused
+ Parameters:
+        method: Parsed info that determines how the indiviudals will crossover
+        mate: Reference to an second individual that will be crossed with
+        rng: Random stream to draw the crossover point or mask from
+        child1, child2: MAXSAT individuals to overwrite with the offspring. Neither may
+                        be this individual or the mate
+*/
+void MAXSATIndividual::breedInto(CrossoverMethod method, const Individual& mate, Random& rng,
+                                 Individual& child1, Individual& child2) const
+{
+    const MAXSATIndividual& satMate = static_cast<const MAXSATIndividual&>(mate);
+    MAXSATIndividual& bred1Ind = static_cast<MAXSATIndividual&>(child1);
+    MAXSATIndividual& bred2Ind = static_cast<MAXSATIndividual&>(child2);
+    if (method == CrossoverMethod::onePoint)
+        breedInto<CrossoverMethod::onePoint>(satMate, rng, bred1Ind, bred2Ind);
+    else if (method == CrossoverMethod::uniform)
+        breedInto<CrossoverMethod::uniform>(satMate, rng, bred1Ind, bred2Ind);
+}
+
+/*
+ Breeds the MAXSAT individual and a given mate as above, with the crossover method
+ fixed at compile time
+ Parameters:
+        method: How the individuals will crossover
+        satMate: The MAXSAT individual that will be crossed with
+        rng: Random stream to draw the crossover point or mask from
+        bred1Ind, bred2Ind: MAXSAT individuals to overwrite with the offspring. Neither
+                            may be this individual or the mate
+*/
+template <CrossoverMethod method>
+void MAXSATIndividual::breedInto(const MAXSATIndividual& satMate, Random& rng,
+                                 MAXSATIndividual& bred1Ind, MAXSATIndividual& bred2Ind) const
+{
+    // Start the offspring as copies of the indiviudal and its mate
+    bred1Ind.cnf = cnf;
+    bred2Ind.cnf = cnf;
     
-    // Initialize two vectors with for the indiviudal and its mate
-    std::vector<bool> bred1(data);
-    std::vector<bool> bred2(satMate.data);
+    // The offspring share the cache only if both parents' hashes are kept
+    bool hashed = cache && satMate.cache;
+    bred1Ind.cache = bred2Ind.cache = (hashed ? cache : NULL);
+    bred1Ind.data = data;
+    bred2Ind.data = satMate.data;
+    std::vector<uint64_t>& bred1 = bred1Ind.data;
+    std::vector<uint64_t>& bred2 = bred2Ind.data;
 
     // For "One Point" crossover, pick an index in the data to "cut" the individuals,
-    // and swap the info between the individuals across that point
+    // and swap the info between the individuals across that point. Whole words
+    // below the cut are swapped, and the word holding the cut is spliced with a mask
     if (method == CrossoverMethod::onePoint) {
-        int crossPoint = static_cast<double>(rand()) / RAND_MAX * data.size();
-        for (int i = 0; i < crossPoint; i++) {
+        int crossPoint = rng.nextInt(cnf->getNumVars() + 1);
+        int crossWord = crossPoint >> 6;
+        for (int i = 0; i < crossWord; i++) {
             bred1[i] = satMate.data[i];
             bred2[i] = data[i];
         }
+        if (crossPoint & 63) {
+            uint64_t low = (static_cast<uint64_t>(1) << (crossPoint & 63)) - 1;
+            bred1[crossWord] = (satMate.data[crossWord] & low) | (data[crossWord] & ~low);
+            bred2[crossWord] = (data[crossWord] & low) | (satMate.data[crossWord] & ~low);
+        }
+        
+        // Each offspring's hash is its first parent's, with the words that came
+        // from the other parent swapped in (both offspring swap the same ones)
+        if (hashed) {
+            uint64_t swapped = 0;
+            for (int i = 0; i < crossWord; i++)
+                swapped ^= wordHash(i, data[i]) ^ wordHash(i, satMate.data[i]);
+            bred1Ind.hash = hash ^ swapped;
+            bred2Ind.hash = satMate.hash ^ swapped;
+            if (crossPoint & 63) {
+                bred1Ind.hash ^= wordHash(crossWord, data[crossWord]) ^ wordHash(crossWord, bred1[crossWord]);
+                bred2Ind.hash ^= wordHash(crossWord, satMate.data[crossWord]) ^ wordHash(crossWord, bred2[crossWord]);
+            }
+        }
         
     // For "Uniform" crossover, decide with equal random chance to swap
-    // the data at an index between the two individuals
+    // the data at an index between the two individuals, 64 indices at a time
     } else if (method == CrossoverMethod::uniform) {
         for (unsigned int i = 0; i < data.size(); i++) {
-            if (rand() < RAND_MAX / 2) {
-                bred1[i] = data[i];
-                bred2[i] = satMate.data[i];
-            } else {
-                bred1[i] = satMate.data[i];
-                bred2[i] = data[i];
-            }
+            uint64_t m = rng.nextWord();
+            bred1[i] = (data[i] & m) | (satMate.data[i] & ~m);
+            bred2[i] = (satMate.data[i] & m) | (data[i] & ~m);
+        }
+        if (hashed) {
+            bred1Ind.rehash();
+            bred2Ind.rehash();
         }
     }
 
-    // Produce and return two MAXSAT individuals from the crossed over offspring
-    std::shared_ptr<Individual> bred1Pt(new MAXSATIndividual(bred1));
-    std::shared_ptr<Individual> bred2Pt(new MAXSATIndividual(bred2));
-    return std::pair<std::shared_ptr<Individual>, std::shared_ptr<Individual>>(bred1Pt, bred2Pt);
+    // Rescore the offspring from whichever parent they are closest to
+    bred1Ind.evaluated = bred1Ind.countsValid = false;
+    bred2Ind.evaluated = bred2Ind.countsValid = false;
+    bred1Ind.inheritFitness(*this, satMate);
+    bred2Ind.inheritFitness(*this, satMate);
+}
+
+template void MAXSATIndividual::breedInto<CrossoverMethod::onePoint>(const MAXSATIndividual&, Random&,
+                                                                     MAXSATIndividual&, MAXSATIndividual&) const;
+template void MAXSATIndividual::breedInto<CrossoverMethod::uniform>(const MAXSATIndividual&, Random&,
+                                                                    MAXSATIndividual&, MAXSATIndividual&) const;
+
+/*
+ Overwrites the individual with a copy of another MAXSAT individual, fitness included.
+ The vectors are assigned rather than reallocated, so no memory is allocated once
+ the individual has held an assignment for the problem
+ Parameters:
+        other: The MAXSAT individual to copy
+*/
+void MAXSATIndividual::copyFrom(const Individual& other)
+{
+    copyFrom(static_cast<const MAXSATIndividual&>(other));
 }
 
 /*
- Evalutes the fitness of MAXSAT individuals by referencing the Conjunctive Normal Form clauses. 
+ Copies the packed assignment out to raw memory
+ Parameters:
+        words: Where to write the genomeWords() words of the assignment
+*/
+void MAXSATIndividual::writeGenome(uint64_t* words) const
+{
+    std::copy(data.begin(), data.end(), words);
+}
+
+/*
+ Overwrites the assignment with one written by writeGenome. The fitness is rescored
+ when next needed
+ Parameters:
+        words: The genomeWords() words of the assignment
+*/
+void MAXSATIndividual::readGenome(const uint64_t* words)
+{
+    std::copy(words, words + data.size(), data.begin());
+    if (!data.empty())
+        data.back() &= lastWordMask();
+    evaluated = false;
+    countsValid = false;
+    if (cache)
+        rehash();
+}
+
+/*
+ Evalutes the fitness of MAXSAT individuals by referencing the Conjunctive Normal Form clauses.
  Fitness here is a simple count of how many clauses are satisfied by the boolean assignment 
- represented by the data in the MAXSAT individual
+ represented by the data in the MAXSAT individual. An assignment found in the fitness
+ cache is not scored again
  Returns the fitness (num of satisified clauses)
 */
 double MAXSATIndividual::evaluateFitness() const
 {
-    // NOTE clauses is a global that contains the MAXSAT problem
-    // Loop over clauses and count number of true clauses
+    // Individuals that were already scored (and only changed incrementally since)
+    // carry their fitness with them
+    if (evaluated)
+        return static_cast<double>(numSatisfied);
+    
+    int fitness;
+    if (cache && cache->lookup(hash, fitness)) {
+        numSatisfied = fitness;
+        evaluated = true;
+        return static_cast<double>(numSatisfied);
+    }
+    
+    countClauses();
+    if (cache)
+        cache->store(hash, numSatisfied);
+    return static_cast<double>(numSatisfied);
+}
+
+/*
+ Scores the individual from scratch, keeping the per-clause counts of true literals so
+ later mutations can update the fitness incrementally
+*/
+void MAXSATIndividual::countClauses() const
+{
+    // Walk the flat clause database once, counting the true literals of each
+    // clause and the number of true clauses
+    const unsigned int* literals = cnf->getLiterals();
+    const unsigned int* offsets = cnf->getOffsets();
+    int numClauses = cnf->getNumClauses();
+    trueCounts.resize(numClauses);
+    unsatisfied.clear();
+    listed.assign(numClauses, 0);
+    
     int numCorrectClauses = 0;
-    for (unsigned int i = 0; i < clauses.size(); i++) {
-		for (unsigned int j = 0; j < clauses[i].size(); j++) {
-            // If non-negated variable in clause is set to true, clause is true
-            // If negatated variable in clause is set to false, clause is true
-			if ((clauses[i][j] > 0 && data[abs(clauses[i][j]) - 1] == 1) 
-				|| (clauses[i][j] < 0 && data[abs(clauses[i][j]) - 1] == 0)) {
-					numCorrectClauses++;
-					break;
-			}
-		}
-	}
+    for (int i = 0; i < numClauses; i++) {
+        unsigned int count = 0;
+        for (unsigned int j = offsets[i]; j < offsets[i + 1]; j++) {
+            // A literal is true when its variable's value differs from its
+            // negation bit (non-negated and true, or negated and false)
+            unsigned int lit = literals[j];
+            int var = CNF::literalVar(lit);
+            count += ((data[var >> 6] >> (var & 63)) & 1) != (lit & 1);
+        }
+        trueCounts[i] = count;
+        if (count > 0)
+            numCorrectClauses++;
+        else
+            listUnsatisfied(i);
+    }
+    numSatisfied = numCorrectClauses;
+    evaluated = true;
+    countsValid = true;
+}
+
+/*
+ Evaluates MAXSAT individuals held by their own type. Individuals that carry their
+ fitness or are found in the fitness cache are not rescored; the rest are scored
+ together by the bit-sliced kernel (see BitSlice.cpp), which handles 64 to 256
+ individuals per pass over the clauses. Too few to fill a useful part of a batch are
+ scored one at a time instead, which also gives them clause counts for later
+ incremental updates
+ Parameters:
+        population: The individuals to evaluate, all MAXSAT individuals for the same problem
+        count: How many individuals population holds
+        evaluations: Output, count entries
+*/
+void MAXSATIndividual::evaluateBatch(MAXSATIndividual* const* population, int count, double* evaluations)
+{
+    // Scratch space is kept per thread, so steady-state evaluation does not allocate
+    static thread_local std::vector<const MAXSATIndividual*> pending;
+    static thread_local std::vector<const uint64_t*> genomes;
+    static thread_local std::vector<int> fitness;
+    
+    pending.clear();
+    for (int i = 0; i < count; i++) {
+        const MAXSATIndividual& individual = *population[i];
+        if (individual.evaluated)
+            continue;
+        int cached;
+        if (individual.cache && individual.cache->lookup(individual.hash, cached)) {
+            individual.numSatisfied = cached;
+            individual.evaluated = true;
+        } else {
+            pending.push_back(&individual);
+        }
+    }
+    
+    if (pending.size() >= 8) {
+        genomes.resize(pending.size());
+        fitness.resize(pending.size());
+        for (unsigned int i = 0; i < pending.size(); i++)
+            genomes[i] = pending[i]->data.data();
+        evaluateBitSliced(*pending[0]->cnf, genomes.data(), genomes.size(), fitness.data());
+        
+        for (unsigned int i = 0; i < pending.size(); i++) {
+            pending[i]->numSatisfied = fitness[i];
+            pending[i]->evaluated = true;
+        }
+    } else {
+        for (unsigned int i = 0; i < pending.size(); i++)
+            pending[i]->countClauses();
+    }
+    for (unsigned int i = 0; i < pending.size(); i++) {
+        if (pending[i]->cache)
+            pending[i]->cache->store(pending[i]->hash, pending[i]->numSatisfied);
+    }
+    
+    for (int i = 0; i < count; i++)
+        evaluations[i] = population[i]->evaluateFitness();
+}
 
-    // Return as double
-	return static_cast<double>(numCorrectClauses);
+/*
+ Evaluates MAXSAT individuals held as plain Individuals, through evaluateBatch
+ Parameters:
+        population: The individuals to evaluate, all MAXSAT individuals for the same problem
+        count: How many individuals population holds
+        evaluations: Output, count entries
+*/
+void MAXSATIndividual::evaluatePopulation(Individual* const* population, int count, double* evaluations) const
+{
+    static thread_local std::vector<MAXSATIndividual*> typed;
+    
+    typed.resize(count);
+    for (int i = 0; i < count; i++)
+        typed[i] = static_cast<MAXSATIndividual*>(population[i]);
+    evaluateBatch(typed.data(), count, evaluations);
 }
 
 /*
@@ -146,8 +659,8 @@ double MAXSATIndividual::evaluateFitness() const
 */
 void MAXSATIndividual::print() const
 {
-    for (unsigned int i = 0; i < data.size(); i++)
-        std::cout << data[i];
+    for (int i = 0; i < cnf->getNumVars(); i++)
+        std::cout << at(i);
     std::cout << std::endl;
 }
 
@@ -162,11 +675,21 @@ std::shared_ptr<Individual> MAXSATIndividual::clone() const
 }
 
 /*
- Returns the value at the index of the data (here for PBIL)
+ Resamples the individual in place from a probability vector for a PBIL algorithm
+ Parameters:
+        probVect: Reference to the probability vector that will determine bit assignment
+        rng: Random stream to draw the assignment from
 */
-int MAXSATIndividual::at(int index) const
+void MAXSATIndividual::resamplePBIL(const std::vector<double>& probVect, Random& rng)
 {
-    return data[index];
+    data.assign(numWords(probVect.size()), 0);
+    for (unsigned int i = 0; i < probVect.size(); i++) {
+        if (rng.nextDouble() < probVect[i])
+            data[i >> 6] |= static_cast<uint64_t>(1) << (i & 63);
+    }
+    evaluated = countsValid = false;
+    if (cache)
+        rehash();
 }
 
 /*
@@ -174,9 +697,12 @@ int MAXSATIndividual::at(int index) const
  construction from a general PBIL algorithm.
  Parameters:
         probVect: Reference to the probability vector for PBIL individual generation
+        rng: Random stream to draw the individual from
  Returns the pointer to the newly generated individual
 */
-std::shared_ptr<Individual> MAXSATIndividual::generateIndividualPBIL(const std::vector<double>& probVect)
+std::shared_ptr<Individual> MAXSATIndividual::generateIndividualPBIL(const std::vector<double>& probVect, Random& rng)
 {
-    return std::shared_ptr<Individual>(new MAXSATIndividual(probVect));
+    MAXSATIndividual* individual = new MAXSATIndividual(*cnf, probVect, rng);
+    individual->setFitnessCache(cache);
+    return std::shared_ptr<Individual>(individual);
 }
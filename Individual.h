@@ -1,12 +1,17 @@
 #pragma once
 
 #include "readCNF.h"
+#include "Random.h"
+#include "LocalSearch.h"
+#include "FitnessCache.h"
 
 #include <utility>
 #include <memory>
 #include <cstdlib>
 #include <iostream>
 #include <vector>
+#include <cstdint>
+#include <algorithm>
 
 /*
  
@@ -21,6 +26,7 @@
 */
 
 enum class CrossoverMethod { onePoint, uniform };
+enum class MutationMethod { uniform, focused };
 
 // Abstract base class used to represent a candidate solution.
 // Genetic algorithm and PBIL are written in terms of the Individual class, so that
@@ -31,18 +37,47 @@ public:
     // Virtual destructor necessary to ensure proper object destruction
     virtual ~Individual() {}
 
-    // Method that mutates the object
-    virtual void mutate(double mutationProb) = 0;
+    // Method that mutates the object, drawing from the given random stream
+    virtual void mutate(double mutationProb, Random& rng) = 0;
+    
+    // Mutates the object with the given mutation method. Individuals with no other
+    // methods than uniform mutation mutate as above by default
+    virtual void mutate(MutationMethod method, double mutationProb, Random& rng) { mutate(mutationProb, rng); }
+    
+    // Improves the object by local search before it is evaluated (see LocalSearch.h).
+    // By default Individuals are left as they are
+    virtual void localSearch(const LocalSearchSettings& settings, Random& rng) {}
 
     // Method that combines two Individuals to create a new Individual using
-    // the crossover method specified.
+    // the crossover method specified, drawing from the given random stream.
     // std::shared__ptr is used, so that the Individual (created on the
     // heap) is deleted automatically
     virtual std::pair<std::shared_ptr<Individual>, std::shared_ptr<Individual>> 
-            breed(CrossoverMethod method, const Individual& mate) const = 0;
+            breed(CrossoverMethod method, const Individual& mate, Random& rng) const = 0;
+    
+    // Like breed, but overwrites two existing Individuals (of the same type) with the
+    // offspring, so that populations can be reused without allocating
+    virtual void breedInto(CrossoverMethod method, const Individual& mate, Random& rng,
+                           Individual& child1, Individual& child2) const = 0;
+    
+    // Overwrites the object with a copy of another Individual of the same type,
+    // reusing its storage
+    virtual void copyFrom(const Individual& other) = 0;
 
-    // Returns a positive double representing the fitness of the Individual
+    // Returns a positive double representing the fitness of the Individual.
+    // Subclasses may cache the result, so unchanged Individuals are not rescored
     virtual double evaluateFitness() const = 0;
+    
+    // Evaluates the count Individuals of population (all of this type) into the matching
+    // entries of evaluations. Subclasses may score the Individuals in batches; by
+    // default each one's evaluateFitness is called
+    virtual void evaluatePopulation(Individual* const* population, int count, double* evaluations) const;
+    
+    // Batch evaluation for code compiled for a type of individual: Ind::evaluateBatch
+    // goes through evaluatePopulation here, and straight to the batch kernel of a
+    // subclass that hides it with its own (see MAXSATIndividual)
+    static void evaluateBatch(Individual* const* population, int count, double* evaluations)
+        { if (count > 0) population[0]->evaluatePopulation(population, count, evaluations); }
 
     // Clones the object for use in the Sampler class
     virtual std::shared_ptr<Individual> clone() const = 0;
@@ -53,30 +88,138 @@ public:
     // Gets the data at an index of the individual dataset
     virtual int at(int index) const = 0;
     
+    // The genome as raw 64-bit words, so Individuals can be passed between processes.
+    // readGenome takes words written by writeGenome of an Individual of the same
+    // type and problem
+    virtual int genomeWords() const = 0;
+    virtual void writeGenome(uint64_t* words) const = 0;
+    virtual void readGenome(const uint64_t* words) = 0;
+    
+    // Whether the genome is a packed bit string (bit i % 64 of word i / 64) whose bit i
+    // is drawn with probability probVect[i] for PBIL, so that PBIL can sample genomes
+    // itself and read them in with readGenome
+    virtual bool isBitString() const { return false; }
+    
     // Generates a new individual from a probability vector for PBIL
-    virtual std::shared_ptr<Individual> generateIndividualPBIL(const std::vector<double>& probVect) = 0;
+    virtual std::shared_ptr<Individual> generateIndividualPBIL(const std::vector<double>& probVect, Random& rng) = 0;
+    
+    // Like generateIndividualPBIL, but resamples the object in place
+    virtual void resamplePBIL(const std::vector<double>& probVect, Random& rng) = 0;
 };
 
+// Pointers to individuals that are all of type Ind, for the engines to hold a population
+// by its own type. They stay valid while the individuals do, since the engines overwrite
+// individuals in place rather than replacing them
+template <class Ind>
+std::vector<Ind*> typedIndividuals(const std::vector<std::shared_ptr<Individual>>& individuals)
+{
+    std::vector<Ind*> typed;
+    typed.reserve(individuals.size());
+    for (unsigned int i = 0; i < individuals.size(); i++)
+        typed.push_back(static_cast<Ind*>(individuals[i].get()));
+    return typed;
+}
+
 // An individual subclass to apply genetic and PBIL algorithms to MAXSAT problems.
+// The assignment is bit-packed into 64-bit words (variable i is bit i % 64 of
+// word i / 64), so crossover and mutation work a word at a time. Bits past the
+// last variable in the final word are always kept at 0.
+// Fitness is tracked incrementally: once evaluated, an individual keeps the number
+// of true literals in every clause, so flipping a few bits only rescores the
+// clauses that contain them (found through the CNF occurrence index). Individuals
+// scored in a batch by evaluateBatch keep only their fitness, not the counts.
+// Only individuals with the counts keep a list of their unsatisfied clauses, which
+// focused mutation picks its flips from; for the rest it samples random clauses.
+// The class is final, so code holding MAXSATIndividuals by their own type (like the
+// engines' run loops compiled for it) calls its methods directly rather than through
+// the vtable, using the typed breedInto, copyFrom and evaluateBatch below.
+// Given a fitness cache, an individual also keeps a 64-bit hash of its assignment,
+// updated a word at a time as bits change, and looks its fitness up by that hash
+// before scoring itself.
 // Class and method documentation can be found in Individual.cpp
-class MAXSATIndividual : public Individual {
+class MAXSATIndividual final : public Individual {
 public:
     
-	MAXSATIndividual(int size);
-	MAXSATIndividual(std::vector<bool> data_);
-    MAXSATIndividual(const std::vector<double>& probVect);
+	MAXSATIndividual(const CNF& cnf_, Random& rng);
+	MAXSATIndividual(const CNF& cnf_, std::vector<uint64_t> data_);
+    MAXSATIndividual(const CNF& cnf_, const std::vector<double>& probVect, Random& rng);
     
-    void mutate(double mutationProb);
+    void mutate(double mutationProb, Random& rng);
+    void mutate(double mutationProb, Random& rng, std::vector<int>& flipped);
+    void mutate(MutationMethod method, double mutationProb, Random& rng);
+    void localSearch(const LocalSearchSettings& settings, Random& rng);
     std::pair<std::shared_ptr<Individual>, std::shared_ptr<Individual>>
-            breed(CrossoverMethod method, const Individual& mate) const;
+            breed(CrossoverMethod method, const Individual& mate, Random& rng) const;
+    void breedInto(CrossoverMethod method, const Individual& mate, Random& rng,
+                   Individual& child1, Individual& child2) const;
+    template <CrossoverMethod method>
+    void breedInto(const MAXSATIndividual& mate, Random& rng,
+                   MAXSATIndividual& child1, MAXSATIndividual& child2) const;
+    void copyFrom(const Individual& other);
+    void copyFrom(const MAXSATIndividual& other) { *this = other; }
     double evaluateFitness() const;
+    void evaluatePopulation(Individual* const* population, int count, double* evaluations) const;
+    static void evaluateBatch(MAXSATIndividual* const* population, int count, double* evaluations);
     void print() const;
     std::shared_ptr<Individual> clone() const;
     
-    int at(int index) const;
-    std::shared_ptr<Individual> generateIndividualPBIL(const std::vector<double>& probVect);
+    int at(int index) const { return (data[index >> 6] >> (index & 63)) & 1; }
+    int genomeWords() const { return static_cast<int>(data.size()); }
+    void writeGenome(uint64_t* words) const;
+    void readGenome(const uint64_t* words);
+    bool isBitString() const { return true; }
+    std::shared_ptr<Individual> generateIndividualPBIL(const std::vector<double>& probVect, Random& rng);
+    void resamplePBIL(const std::vector<double>& probVect, Random& rng);
+    
+    const std::vector<uint64_t>& getWords() const { return data; }
     
+    // Shares a fitness cache (or none, if NULL) with the individual and the ones
+    // cloned or bred from it
+    void setFitnessCache(FitnessCache* cache_);
+    
+    // Number of words needed to hold numBits bits
+    static int numWords(int numBits) { return (numBits + 63) >> 6; }
     
 private:
-    std::vector<bool> data;
+    uint64_t lastWordMask() const;
+    void flipCounts(int word, uint64_t flips, uint64_t oldWord);
+    void listUnsatisfied(unsigned int clause) const;
+    int pickUnsatisfiedVar(Random& rng);
+    void inheritFitness(const MAXSATIndividual& parent1, const MAXSATIndividual& parent2);
+    int flipBudget() const { return cnf->getNumVars() / 4; }
+    void countClauses() const;
+    void rehash();
+    
+    // The hash of the assignment is the XOR of the hashes of its words, each mixed
+    // with the word's position, so changing a word changes the hash by two terms
+    static uint64_t wordHash(int index, uint64_t word)
+    {
+        uint64_t z = word + (static_cast<uint64_t>(index) + 1) * 0x9E3779B97F4A7C15ULL;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+    
+    // The problem this individual is an assignment for (not owned)
+    const CNF* cnf;
+    std::vector<uint64_t> data;
+    
+    // Cached fitness state: the number of satisfied clauses (while evaluated is
+    // true) and the number of true literals in each clause (while countsValid is
+    // true, which implies evaluated)
+    mutable std::vector<unsigned int> trueCounts;
+    
+    // Also while countsValid is true, a list holding every unsatisfied clause, along
+    // with clauses satisfied since they were listed (which are dropped when found),
+    // and whether each clause is on the list
+    mutable std::vector<unsigned int> unsatisfied;
+    mutable std::vector<uint8_t> listed;
+    mutable int numSatisfied;
+    mutable bool evaluated;
+    mutable bool countsValid;
+    
+    // The cache shared with the rest of the population (not owned), and the hash of
+    // the assignment, kept up to date only while there is a cache
+    FitnessCache* cache;
+    uint64_t hash;
 };
\ No newline at end of file
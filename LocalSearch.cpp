@@ -0,0 +1,211 @@
+#include "LocalSearch.h"
+
+/*
+ 
+ ****************************
+ *       LocalSearch        *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+ 
+ The LocalSearch class improves a MAXSAT assignment by flipping one variable at a
+ time. WalkSAT picks an unsatisfied clause at random and flips one of its variables:
+ one that breaks no clause if there is one, otherwise (with probability noise) a random
+ one, or else the one that breaks the fewest clauses. GSAT flips the variable of the
+ whole problem whose flip gains the most satisfied clauses (make minus break), even if
+ that gain is negative, which costs time proportional to the number of variables per
+ flip. Either way the search keeps the best assignment it passes through.
+ 
+ A flip only touches the clauses the variable occurs in (through the CNF occurrence
+ index). A clause whose true literal count goes between 0 and 1 changes the make
+ count of every variable in it and the break count of the flipped variable, and one
+ whose count goes between 1 and 2 changes the break count of its single true
+ variable, found as the XOR of its true variables.
+ 
+*/
+
+/*
+ Runs a bounded local search on an assignment
+ Parameters:
+        cnf_: The problem the assignment is for
+        words_: The packed assignment, overwritten with the best one found
+        settings: The search method and how many flips it may make
+        rng: Random stream to draw the search's choices from
+ Returns the number of clauses the final assignment satisfies
+*/
+int LocalSearch::run(const CNF& cnf_, uint64_t* words_, const LocalSearchSettings& settings, Random& rng)
+{
+    cnf = &cnf_;
+    words = words_;
+    init();
+    
+    unsigned int best = unsatisfied.size();
+    trail.clear();
+    for (int i = 0; i < settings.maxFlips && !unsatisfied.empty(); i++) {
+        int var = (settings.method == LocalSearchMethod::gsat) ? pickGSAT(rng) : pickWalkSAT(rng, settings.noise);
+        flip(var);
+        trail.push_back(var);
+        if (unsatisfied.size() < best) {
+            best = unsatisfied.size();
+            trail.clear();
+        }
+    }
+    
+    // Go back to the best assignment, which needs no more bookkeeping
+    for (unsigned int i = 0; i < trail.size(); i++)
+        words[trail[i] >> 6] ^= static_cast<uint64_t>(1) << (trail[i] & 63);
+    return cnf->getNumClauses() - numEmpty - best;
+}
+
+/*
+ Builds the clause counts, unsatisfied list, and make and break counts of the assignment.
+ Empty clauses can never be satisfied, so they are counted but left off the list
+*/
+void LocalSearch::init()
+{
+    int numClauses = cnf->getNumClauses();
+    trueCounts.assign(numClauses, 0);
+    trueVars.assign(numClauses, 0);
+    unsatisfied.clear();
+    unsatisfiedIndex.assign(numClauses, -1);
+    makes.assign(cnf->getNumVars(), 0);
+    breaks.assign(cnf->getNumVars(), 0);
+    numEmpty = 0;
+    
+    for (int c = 0; c < numClauses; c++) {
+        if (cnf->clauseBegin(c) == cnf->clauseEnd(c)) {
+            numEmpty++;
+            continue;
+        }
+        for (const unsigned int* lit = cnf->clauseBegin(c); lit != cnf->clauseEnd(c); ++lit) {
+            int var = CNF::literalVar(*lit);
+            if (value(var) != static_cast<int>(CNF::literalNegated(*lit))) {
+                trueCounts[c]++;
+                trueVars[c] ^= var;
+            }
+        }
+        if (trueCounts[c] == 0) {
+            addUnsatisfied(c);
+            for (const unsigned int* lit = cnf->clauseBegin(c); lit != cnf->clauseEnd(c); ++lit)
+                makes[CNF::literalVar(*lit)]++;
+        } else if (trueCounts[c] == 1) {
+            breaks[trueVars[c]]++;
+        }
+    }
+}
+
+/*
+ Flips a variable, updating the search state for every clause it occurs in
+ Parameters:
+        var: The variable to flip
+*/
+void LocalSearch::flip(int var)
+{
+    unsigned int oldValue = value(var);
+    words[var >> 6] ^= static_cast<uint64_t>(1) << (var & 63);
+    
+    for (const unsigned int* occ = cnf->occurrenceBegin(var); occ != cnf->occurrenceEnd(var); ++occ) {
+        int clause = *occ >> 1;
+        if (oldValue == (*occ & 1)) {
+            // The literal becomes true
+            if (trueCounts[clause]++ == 0) {
+                removeUnsatisfied(clause);
+                for (const unsigned int* lit = cnf->clauseBegin(clause); lit != cnf->clauseEnd(clause); ++lit)
+                    makes[CNF::literalVar(*lit)]--;
+                breaks[var]++;
+            } else if (trueCounts[clause] == 2) {
+                breaks[trueVars[clause]]--;
+            }
+            trueVars[clause] ^= var;
+        } else {
+            // The literal becomes false
+            trueVars[clause] ^= var;
+            if (--trueCounts[clause] == 0) {
+                addUnsatisfied(clause);
+                for (const unsigned int* lit = cnf->clauseBegin(clause); lit != cnf->clauseEnd(clause); ++lit)
+                    makes[CNF::literalVar(*lit)]++;
+                breaks[var]--;
+            } else if (trueCounts[clause] == 1) {
+                breaks[trueVars[clause]]++;
+            }
+        }
+    }
+}
+
+/*
+ Adds a clause to the unsatisfied list
+*/
+void LocalSearch::addUnsatisfied(int clause)
+{
+    unsatisfiedIndex[clause] = unsatisfied.size();
+    unsatisfied.push_back(clause);
+}
+
+/*
+ Removes a clause from the unsatisfied list, by moving the last clause of the list
+ into its place
+*/
+void LocalSearch::removeUnsatisfied(int clause)
+{
+    int index = unsatisfiedIndex[clause];
+    int last = unsatisfied.back();
+    unsatisfied[index] = last;
+    unsatisfiedIndex[last] = index;
+    unsatisfied.pop_back();
+    unsatisfiedIndex[clause] = -1;
+}
+
+/*
+ Picks the variable to flip in a WalkSAT step
+ Parameters:
+        rng: Random stream to draw the clause and variable from
+        noise: Probability of flipping a random variable of the clause when every
+            variable of it would break some clause
+ Returns the variable to flip
+*/
+int LocalSearch::pickWalkSAT(Random& rng, double noise) const
+{
+    int clause = unsatisfied[rng.nextInt(unsatisfied.size())];
+    const unsigned int* begin = cnf->clauseBegin(clause);
+    int length = cnf->clauseEnd(clause) - begin;
+    
+    // Find the variable breaking the fewest clauses, picking among ties at random
+    int best = -1;
+    int ties = 0;
+    for (int i = 0; i < length; i++) {
+        int var = CNF::literalVar(begin[i]);
+        if (best < 0 || breaks[var] < breaks[best]) {
+            best = var;
+            ties = 1;
+        } else if (breaks[var] == breaks[best] && rng.nextInt(++ties) == 0) {
+            best = var;
+        }
+    }
+    
+    if (breaks[best] > 0 && rng.nextDouble() < noise)
+        return CNF::literalVar(begin[rng.nextInt(length)]);
+    return best;
+}
+
+/*
+ Picks the variable to flip in a GSAT step
+ Parameters:
+        rng: Random stream to break ties between variables with
+ Returns the variable whose flip gains the most satisfied clauses
+*/
+int LocalSearch::pickGSAT(Random& rng) const
+{
+    int best = 0;
+    int ties = 0;
+    for (int var = 0; var < cnf->getNumVars(); var++) {
+        int score = makes[var] - breaks[var];
+        int bestScore = makes[best] - breaks[best];
+        if (var == 0 || score > bestScore) {
+            best = var;
+            ties = 1;
+        } else if (score == bestScore && rng.nextInt(++ties) == 0) {
+            best = var;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "readCNF.h"
+#include "Random.h"
+
+#include <cstdint>
+#include <vector>
+
+/*
+ 
+ ****************************
+ *       LocalSearch        *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+ 
+ See LocalSearch.cpp for more documentation.
+ 
+*/
+
+enum class LocalSearchMethod { none, walkSAT, gsat };
+
+// Settings for improving individuals by local search before they are evaluated (the
+// memetic mode): the method, the largest number of variables flipped per individual,
+// and the probability of a WalkSAT step flipping a random variable of the clause
+// rather than the one that breaks the fewest clauses.
+struct LocalSearchSettings {
+    LocalSearchMethod method;
+    int maxFlips;
+    double noise;
+    
+    LocalSearchSettings() : method(LocalSearchMethod::none), maxFlips(100), noise(0.5) {}
+};
+
+// Runs WalkSAT or GSAT on packed MAXSAT assignments (variable i is bit i % 64 of
+// word i / 64). The state needed to pick flips quickly is built once per search and
+// then kept up to date flip by flip: the number of true literals in every clause, the
+// list of unsatisfied clauses, and the make and break count of every variable (the
+// number of clauses flipping it would satisfy, or leave unsatisfied). One LocalSearch
+// is reused for many searches, so its buffers are only allocated once per thread.
+// Class and method documentation can be found in LocalSearch.cpp
+class LocalSearch {
+public:
+    // Improves the assignment in place, returning how many clauses it satisfies
+    int run(const CNF& cnf_, uint64_t* words_, const LocalSearchSettings& settings, Random& rng);
+
+private:
+    void init();
+    void flip(int var);
+    void addUnsatisfied(int clause);
+    void removeUnsatisfied(int clause);
+    int pickWalkSAT(Random& rng, double noise) const;
+    int pickGSAT(Random& rng) const;
+    
+    int value(int var) const { return (words[var >> 6] >> (var & 63)) & 1; }
+    
+    // The problem and the assignment being searched (neither owned)
+    const CNF* cnf;
+    uint64_t* words;
+    
+    // The number of true literals of every clause, and the XOR of their variables,
+    // which is the one true variable of a clause with a single true literal
+    std::vector<unsigned int> trueCounts;
+    std::vector<unsigned int> trueVars;
+    
+    // The unsatisfied (non-empty) clauses, where each clause is in that list (-1 if
+    // it isn't), and the number of empty clauses
+    std::vector<int> unsatisfied;
+    std::vector<int> unsatisfiedIndex;
+    int numEmpty;
+    
+    std::vector<int> makes;
+    std::vector<int> breaks;
+    
+    // Variables flipped since the best assignment of the search, undone at the end
+    std::vector<int> trail;
+};
@@ -0,0 +1,54 @@
+#include "Mailbox.h"
+
+/*
+ 
+ ****************************
+ *         Mailbox          *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+ 
+ The Mailbox class passes migrants between the islands of an island model GA (see
+ GeneticAlgorithm.cpp). Each island sends its best individuals to its neighbours
+ every few generations without waiting for them, so islands never synchronize.
+ 
+*/
+
+/*
+ Constructor for the mailbox, which allocates the three batches
+ Parameters:
+        prototype: An Individual of the type to be sent, cloned to fill the batches
+        capacity: Largest number of migrants sent at once
+*/
+Mailbox::Mailbox(const Individual& prototype, int capacity)
+    : middle(1), sendIndex(0), receiveIndex(2)
+{
+    for (int b = 0; b < 3; b++) {
+        for (int i = 0; i < capacity; i++)
+            batches[b].push_back(prototype.clone());
+        counts[b] = 0;
+    }
+}
+
+/*
+ Publishes the outgoing batch, and takes back an older batch to fill next time
+ Parameters:
+        count: Number of migrants filled in at the start of the outgoing batch
+*/
+void Mailbox::send(int count)
+{
+    counts[sendIndex] = count;
+    sendIndex = middle.exchange(sendIndex | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
+
+/*
+ Takes the most recently sent batch, if it has not been received yet
+ Returns whether a new batch was received
+*/
+bool Mailbox::receive()
+{
+    if (!(middle.load(std::memory_order_relaxed) & FRESH))
+        return false;
+    receiveIndex = middle.exchange(receiveIndex, std::memory_order_acq_rel) & ~FRESH;
+    return true;
+}
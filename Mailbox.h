@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Individual.h"
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/*
+ 
+ ****************************
+ *         Mailbox          *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+ 
+ See Mailbox.cpp for more documentation.
+ 
+*/
+
+// A lock-free mailbox carrying batches of migrant Individuals from one island to
+// another (one sender thread and one receiver thread). It is triple buffered: the
+// sender fills a batch it owns and swaps it with the shared middle batch, and the
+// receiver swaps its own batch for the middle one when a fresh batch is waiting.
+// Neither side ever waits, and a batch that was never received is replaced by the
+// next one sent. Migrants are copied into preallocated Individuals, so sending and
+// receiving never allocate.
+// Class and method documentation can be found in Mailbox.cpp
+class Mailbox {
+public:
+    Mailbox(const Individual& prototype, int capacity);
+    
+    // Sender side: the batch to fill, then publishing the first count of it
+    std::vector<std::shared_ptr<Individual>>& outgoing() { return batches[sendIndex]; }
+    void send(int count);
+    
+    // Receiver side: takes the latest batch if a new one was sent since the last
+    // receive, after which incoming() holds it
+    bool receive();
+    const std::vector<std::shared_ptr<Individual>>& incoming() const { return batches[receiveIndex]; }
+    int incomingCount() const { return counts[receiveIndex]; }
+    
+private:
+    // Set in middle when the middle batch has not been received yet
+    static const int FRESH = 4;
+    
+    std::vector<std::shared_ptr<Individual>> batches[3];
+    int counts[3];
+    
+    // Index of the shared batch (plus FRESH), and the batches owned by each side
+    std::atomic<int> middle;
+    int sendIndex;
+    int receiveIndex;
+};
@@ -31,6 +31,23 @@
         mutationShift: Proportional amount that the probVect will be mutated at an index
         numIter: Number of interations to run the algorithm
         maxSolution_: Maximum soltution for the abstract problem (different than the best POSSIBLE solution)
+        problem_: The problem being solved, referenced when printing results
+        numThreads_: Number of threads to sample and evaluate each iteration's individuals with
+        batchSize_: Number of individuals each thread samples and evaluates at a time, keeping
+            only the best and worst of them (0 to sample a thread's whole share at once)
+        learnSize_: Number of best and of worst individuals of each iteration that the
+            probability vector is updated from
+        seed_: Seed of the run, from which the PBIL's random streams are split
+        preprocessor_: How problem_ was simplified from the original problem, used to report
+            results in terms of the original (NULL if it was not)
+        shared_: Segment to exchange individuals through with other processes solving the
+            same problem (NULL to run alone)
+        localSearch_: How to improve the best individual of each iteration by local search
+            before learning from it (by default it is not)
+        precision_: The number format bit string individuals' probabilities are learned
+            in (others always use doubles)
+        engine_: The run loop for the type of sampleIndividual (see engine). By default
+            the loop for Individual is used, which works for any subclass
 */
 PBIL::PBIL(int probVectSize,
            std::shared_ptr<Individual> sampleIndividual,
@@ -38,8 +55,21 @@ PBIL::PBIL(int probVectSize,
            double posLR, double negLR,
            double mutationProb, double mutationShift,
            int numIter,
-           double maxSolution_)
-    : maxSolution(maxSolution_)
+           double maxSolution_,
+           const CNF& problem_,
+           int numThreads_,
+           int batchSize_,
+           int learnSize_,
+           uint64_t seed_,
+           const Preprocessor* preprocessor_,
+           SharedMigration* shared_,
+           const LocalSearchSettings& localSearch_,
+           ProbabilityPrecision precision_,
+           Engine engine_)
+    : maxSolution(maxSolution_), problem(problem_), preprocessor(preprocessor_), shared(shared_),
+      numThreads(numThreads_ < 1 ? 1 : numThreads_), batchSize(batchSize_ < 0 ? 0 : batchSize_),
+      learnSize(std::max(1, learnSize_)), seed(seed_), localSearch(localSearch_), rng(seed_, 1),
+      precision(precision_)
 {
     //init the probability vector
     for (int i = 0; i < probVectSize; i++) {
@@ -47,13 +77,15 @@ PBIL::PBIL(int probVectSize,
     }
     
     // Actually run the PBIL algorithm
-	run(sampleIndividual, numIndividuals, posLR, negLR, mutationProb, mutationShift, numIter);
+    Engine runLoop = engine_ ? engine_ : engine<Individual>();
+	(this->*runLoop)(sampleIndividual, numIndividuals, posLR, negLR, mutationProb, mutationShift, numIter);
 }
 
 /*
  Performs population based incremental learning, producing individuals based on a probability 
  vector, assessing those generations of individuals, then shifting the probability vector towards
  the best solution of that generation in order to generate better solution.
+ Every individual is of type Ind, by which the chunks' batches are held.
  Parameters:
         sampleIndividual: Problem-specific indivudal of the correct type for abstract individual generation
         numIndividuals: Number of individuals to be produced from the probVect in a single interation
@@ -63,6 +95,7 @@ PBIL::PBIL(int probVectSize,
         mutationShift: Proportional amount that the probVect will be mutated at an index
         numIter: Number of interations to run the algorithm
 */
+template <class Ind>
 void PBIL::run(std::shared_ptr<Individual> sampleIndividual,
                int numIndividuals, double posLR, double negLR,
                double mutationProb, double mutationShift, int numIter)
@@ -74,19 +107,98 @@ void PBIL::run(std::shared_ptr<Individual> sampleIndividual,
     topEval = 0.0;
     topSolution = NULL;
     success = false;
+    stoppedByOther = false;
+    
+    // Individuals to read migrants from other processes into
+    arrivals.clear();
+    for (int i = 0; shared && i < shared->getNumMigrants(); i++)
+        arrivals.push_back(sampleIndividual->clone());
+    cursor = 0;
+    
+    // The sampling thresholds of bit string individuals are kept up to date as probVect
+    // changes, rather than rebuilt every iteration
+    sampleBits = sampleIndividual->isBitString();
+    int sampleWords = (probVect.size() + 63) >> 6;
+    learnSize = std::max(1, std::min(learnSize, numIndividuals));
+    learnWords.assign(sampleBits ? static_cast<size_t>(learnSize) * sampleWords : 0, 0);
+    if (sampleBits) {
+        bitSampler.setProbabilities(probVect);
+    }
+    if (!sampleBits)
+        precision = ProbabilityPrecision::double64;
+    if (precision == ProbabilityPrecision::float32)
+        floatProbs.assign(probVect.begin(), probVect.end());
+    
+    // The individuals are split into one chunk per thread, each sampled from its own
+    // random stream so results don't depend on which thread runs which chunk.
+    // Stream 1 of the seed is kept for mutating the probVect. Each chunk allocates
+    // one batch of individuals (and, for bit strings, a buffer to sample them into)
+    // that every iteration resamples in place, and room for the best and worst
+    // individuals it samples
+    ThreadPool pool(numThreads);
+    int numChunks = pool.size();
+    chunks.clear();
+    chunks.resize(numChunks);
+    std::vector<std::vector<Ind*>> batches(numChunks);
+    for (int k = 0; k < numChunks; k++) {
+        Chunk& chunk = chunks[k];
+        chunk.first = chunkBegin(k, numChunks, numIndividuals);
+        chunk.count = chunkBegin(k + 1, numChunks, numIndividuals) - chunk.first;
+        int size = (batchSize > 0) ? std::min(batchSize, chunk.count) : chunk.count;
+        for (int i = 0; i < size; i++)
+            chunk.batch.push_back(sampleIndividual->clone());
+        chunk.evaluations.assign(size, 0.0);
+        chunk.samples.assign(sampleBits ? static_cast<size_t>(size) * sampleWords : 0, 0);
+        for (int i = 0; i < learnSize; i++) {
+            chunk.best.individuals.push_back(sampleIndividual->clone());
+            chunk.worst.individuals.push_back(sampleIndividual->clone());
+        }
+        chunk.rng.reset(new Random(seed, k + 2));
+        batches[k] = typedIndividuals<Ind>(chunk.batch);
+    }
     
 	while (++currIter <= numIter) {
         
-        // Generate the appropriate number of individuals
-        // evaluate all of their solutions, and mark the best and worst
-        for (int i = 0; i < numIndividuals; i++) {
-            population.push_back(sampleIndividual->generateIndividualPBIL(probVect));
-            evaluations.push_back(population[i]->evaluateFitness());
-        }
+        // Generate the appropriate number of individuals (in place), evaluate all of
+        // their solutions (a batch at a time), and keep the best and worst of each chunk
+        pool.run(numChunks, [&](int k) {
+            sampleChunk(chunks[k], batches[k].data());
+        });
 
 		// Find the best and worst solutions (the lowest fitness),
 		// update the probVect, and mutate the probVect
         findBestAndWorst();
+        
+        // Trade with the other processes every few iterations: publish this iteration's
+        // best, and learn from a migrant in its place if one is better. Stop once another
+        // process has found a complete solution
+        if (shared) {
+            if (shared->stopRequested()) {
+                stoppedByOther = true;
+                break;
+            }
+            if (currIter % shared->getInterval() == 0) {
+                shared->publish(*bestSolutions[0], bestEval);
+                shared->offerBest(*topSolution, topEval);
+                
+                // A migrant better than any individual yet becomes the best ever, so a
+                // complete solution from another process ends the run here too
+                int arrived = shared->collect(arrivals, arrivals.size(), cursor);
+                for (int i = 0; i < arrived; i++) {
+                    double eval = arrivals[i]->evaluateFitness();
+                    if (eval > bestEval) {
+                        bestEval = eval;
+                        bestSolutions[0] = arrivals[i];
+                    }
+                    if (eval > topEval) {
+                        topEval = eval;
+                        topSolution->copyFrom(*arrivals[i]);
+                        topIter = currIter;
+                    }
+                }
+            }
+        }
+        
         updateProbVect(posLR, negLR);
         mutateProbVect(mutationProb, mutationShift);
         
@@ -94,16 +206,16 @@ void PBIL::run(std::shared_ptr<Individual> sampleIndividual,
         // If there is the maximum possible fitness given the (generic) problem,
         // end the algorithm and display that best individual
         if (topEval == maxSolution) {
+            if (shared) {
+                shared->offerBest(*topSolution, topEval);
+                shared->requestStop();
+            }
             printSuccess();
             success = true;
             break;
         }
         
         std::cout << "Iteration: " << currIter << std::endl;
-        
-        // Clear the pop and evals for the next generation
-        population.clear();
-        evaluations.clear();
     }
     
     // If the iterations have finished, display the best solution found yet
@@ -111,64 +223,326 @@ void PBIL::run(std::shared_ptr<Individual> sampleIndividual,
         printEnd();
 }
 
+// The run loop is compiled for plain Individuals and for MAXSAT individuals
+template void PBIL::run<Individual>(std::shared_ptr<Individual>, int, double, double, double, double, int);
+template void PBIL::run<MAXSATIndividual>(std::shared_ptr<Individual>, int, double, double, double, double, int);
+
+/*
+ Returns whether one individual ranks ahead of another among the best (or worst)
+ individuals of an iteration. Ties go to the later individual
+ Parameters:
+        best: Whether the ranking is of the best individuals, rather than the worst
+        eval, position: The fitness of the first individual, and its position among the
+            iteration's individuals
+        otherEval, otherPosition: The same for the second individual
+*/
+static bool outranks(bool best, double eval, int position, double otherEval, int otherPosition)
+{
+    if (eval != otherEval)
+        return best ? eval > otherEval : eval < otherEval;
+    return position > otherPosition;
+}
+
+/*
+ Keeps a copy of an individual among the best (or worst) seen so far, if there is room
+ or it outranks the weakest of them
+ Parameters:
+        extremes: The individuals kept so far
+        best: Whether the best individuals are kept, rather than the worst
+        individual: The individual to offer
+        eval: Its fitness
+        position: Its position among the iteration's individuals
+*/
+void PBIL::offer(Extremes& extremes, bool best, const Individual& individual, double eval, int position)
+{
+    int slot = extremes.size;
+    if (slot == static_cast<int>(extremes.individuals.size())) {
+        slot = extremes.weakest;
+        if (!outranks(best, eval, position, extremes.evals[slot], extremes.positions[slot]))
+            return;
+    } else {
+        extremes.size++;
+    }
+    extremes.individuals[slot]->copyFrom(individual);
+    extremes.evals[slot] = eval;
+    extremes.positions[slot] = position;
+    
+    extremes.weakest = 0;
+    for (int i = 1; i < extremes.size; i++) {
+        if (outranks(best, extremes.evals[extremes.weakest], extremes.positions[extremes.weakest],
+                     extremes.evals[i], extremes.positions[i]))
+            extremes.weakest = i;
+    }
+}
+
+/*
+ Samples and evaluates a chunk's share of the iteration's individuals, a batch at a
+ time, keeping copies of the learnSize best and worst of them
+ Parameters:
+        chunk: The chunk to sample
+        batch: The chunk's batch, held by the individuals' type
+*/
+template <class Ind>
+void PBIL::sampleChunk(Chunk& chunk, Ind* const* batch)
+{
+    int size = chunk.batch.size();
+    int sampleWords = bitSampler.getNumWords();
+    chunk.best.size = chunk.worst.size = 0;
+    chunk.best.evals.resize(learnSize);
+    chunk.best.positions.resize(learnSize);
+    chunk.worst.evals.resize(learnSize);
+    chunk.worst.positions.resize(learnSize);
+    
+    for (int done = 0; done < chunk.count; done += size) {
+        int n = std::min(size, chunk.count - done);
+        if (sampleBits) {
+            bitSampler.sample(*chunk.rng, chunk.samples.data(), n);
+            for (int i = 0; i < n; i++)
+                batch[i]->readGenome(chunk.samples.data() + static_cast<size_t>(i) * sampleWords);
+        } else {
+            for (int i = 0; i < n; i++)
+                batch[i]->resamplePBIL(probVect, *chunk.rng);
+        }
+        Ind::evaluateBatch(batch, n, chunk.evaluations.data());
+        
+        // Only the batch's own best and worst can be among the chunk's, so rank
+        // just enough of the batch to offer those
+        const std::vector<double>& evaluations = chunk.evaluations;
+        int ranked = std::min(learnSize, n);
+        chunk.order.resize(n);
+        for (int pass = 0; pass < 2; pass++) {
+            bool best = (pass == 0);
+            Extremes& extremes = best ? chunk.best : chunk.worst;
+            for (int i = 0; i < n; i++)
+                chunk.order[i] = i;
+            std::partial_sort(chunk.order.begin(), chunk.order.begin() + ranked, chunk.order.end(),
+                              [&evaluations, best](int a, int b) {
+                return outranks(best, evaluations[a], a, evaluations[b], b);
+            });
+            for (int i = 0; i < ranked; i++) {
+                int index = chunk.order[i];
+                offer(extremes, best, *batch[index], evaluations[index], chunk.first + done + index);
+            }
+        }
+    }
+}
+
 /*
- Finds the highest and lowest fitness of the current probability-generated population
- and keeps track of the highest fitness individual of any generation found yet
+ Finds the learnSize highest and lowest fitness individuals of the current
+ probability-generated population from the best and worst of each chunk, and keeps
+ track of the highest fitness individual of any generation found yet
 */
 void PBIL::findBestAndWorst()
 {
-	bestEvalIndex = 0;
-	worstEvalIndex = 0;
-    
-    // Search all the evaluations to find the best (highest fit)
-    // and worst (lowest fit) individuals
-	for (unsigned int i = 0; i < evaluations.size(); i++) {
-		if (evaluations[i] >= evaluations[bestEvalIndex]) 
-			bestEvalIndex = i;
-			
-		if (evaluations[i] <= evaluations[worstEvalIndex])
-			worstEvalIndex = i;
+    // Rank every chunk's best (highest fit) and worst (lowest fit) individuals
+    // together, breaking ties the same way as within a chunk
+    for (int pass = 0; pass < 2; pass++) {
+        bool best = (pass == 0);
+        candidates.clear();
+        for (unsigned int k = 0; k < chunks.size(); k++) {
+            const Extremes& extremes = best ? chunks[k].best : chunks[k].worst;
+            for (int i = 0; i < extremes.size; i++)
+                candidates.push_back(std::make_pair(k, i));
+        }
+        int ranked = std::min(learnSize, static_cast<int>(candidates.size()));
+        std::partial_sort(candidates.begin(), candidates.begin() + ranked, candidates.end(),
+                          [this, best](const std::pair<int, int>& a, const std::pair<int, int>& b) {
+            const Extremes& ea = best ? chunks[a.first].best : chunks[a.first].worst;
+            const Extremes& eb = best ? chunks[b.first].best : chunks[b.first].worst;
+            return outranks(best, ea.evals[a.second], ea.positions[a.second], eb.evals[b.second], eb.positions[b.second]);
+        });
+        
+        std::vector<std::shared_ptr<Individual>>& solutions = best ? bestSolutions : worstSolutions;
+        solutions.clear();
+        for (int i = 0; i < ranked; i++) {
+            const Extremes& extremes = best ? chunks[candidates[i].first].best : chunks[candidates[i].first].worst;
+            solutions.push_back(extremes.individuals[candidates[i].second]);
+            if (i == 0)
+                (best ? bestEval : worstEval) = extremes.evals[candidates[i].second];
+        }
     }
     
-    // Population and evaluations share indeces
-	bestSolution = population[bestEvalIndex];
-	worstSolution = population[worstEvalIndex];
+    // Improve the very best by local search, so the probVect learns from (and the run
+    // keeps) the improved individual
+    if (localSearch.method != LocalSearchMethod::none) {
+        bestSolutions[0]->localSearch(localSearch, rng);
+        bestEval = bestSolutions[0]->evaluateFitness();
+    }
     
     // Check if the best of this generation is the best of any generation
-    if (evaluations[bestEvalIndex] > topEval) {
-        topEval = evaluations[bestEvalIndex];
-        topSolution = bestSolution;
+    // (keeping a copy, since the chunks' individuals are overwritten)
+    if (bestEval > topEval || !topSolution) {
+        topEval = bestEval;
+        if (topSolution)
+            topSolution->copyFrom(*bestSolutions[0]);
+        else
+            topSolution = bestSolutions[0]->clone();
         topIter = currIter;
     }
 }
 
 /*
- First updates the probability vector towards the best solution by shifting
- the values of the probVect towards the value of the solution at that index,
- then updates the probVect "away from the worst solution" by shifting the probVect
- towards the best solution (at a DIFFERENT RATE) if the best and worst solutions 
- have different values at that index
+ Counts, for every bit position, how many of a set of packed genomes have that bit set.
+ The genomes are added into a bit-sliced vertical counter, in which plane b holds bit b
+ of the count of every position of a word. As in the Harley-Seal population count,
+ carry-save adders first combine the genomes four at a time into the ones and twos
+ planes, so that only one ripple carry into the higher planes is needed per four genomes
  Parameters:
-        posLR: Magnitude shift in the probability vector towards the best solution
-        negLR: Magnitude shift in the probability vector away from the worst solution
+        genomes: The packed genomes, one after another
+        numGenomes: Number of genomes
+        numWords: Words in each genome
+        numBits: Bits in each genome
+        counts: Output, the number of genomes with each bit set
+*/
+static void countOnes(const uint64_t* genomes, int numGenomes, int numWords, int numBits, std::vector<int>& counts)
+{
+    int numPlanes = 1;
+    while ((1 << numPlanes) <= numGenomes)
+        numPlanes++;
+    counts.resize(numBits);
+    
+    for (int k = 0; k < numWords; k++) {
+        uint64_t planes[32] = { 0 };
+        const uint64_t* word = genomes + k;
+        int g = 0;
+        for (; g + 4 <= numGenomes; g += 4, word += 4 * numWords) {
+            // Carry-save add: a + b + c = 2 * carry + sum, for every bit position at once
+            uint64_t a = word[0], b = word[numWords], c = word[2 * numWords], d = word[3 * numWords];
+            uint64_t u = planes[0] ^ a;
+            uint64_t twosA = (planes[0] & a) | (u & b);
+            planes[0] = u ^ b;
+            u = planes[0] ^ c;
+            uint64_t twosB = (planes[0] & c) | (u & d);
+            planes[0] = u ^ d;
+            u = planes[1] ^ twosA;
+            uint64_t carry = (planes[1] & twosA) | (u & twosB);
+            planes[1] = u ^ twosB;
+            for (int p = 2; carry; p++) {
+                uint64_t next = planes[p] & carry;
+                planes[p] ^= carry;
+                carry = next;
+            }
+        }
+        for (; g < numGenomes; g++, word += numWords) {
+            uint64_t carry = *word;
+            for (int p = 0; carry; p++) {
+                uint64_t next = planes[p] & carry;
+                planes[p] ^= carry;
+                carry = next;
+            }
+        }
+        
+        int begin = k << 6;
+        int bits = std::min(64, numBits - begin);
+        for (int j = 0; j < bits; j++) {
+            int count = 0;
+            for (int p = 0; p < numPlanes; p++)
+                count |= static_cast<int>((planes[p] >> j) & 1) << p;
+            counts[begin + j] = count;
+        }
+    }
+}
+
+/*
+ Counts, for every index of the probability vector, how many of a set of individuals
+ have a 1 there
+ Parameters:
+        solutions: The individuals to count
+        counts: Output, the count for each index
+*/
+void PBIL::countSolutions(const std::vector<std::shared_ptr<Individual>>& solutions, std::vector<int>& counts)
+{
+    int size = probVect.size();
+    
+    // Bit strings are counted a word at a time, others a value at a time
+    if (sampleBits) {
+        int numWords = bitSampler.getNumWords();
+        for (unsigned int i = 0; i < solutions.size(); i++)
+            solutions[i]->writeGenome(learnWords.data() + i * numWords);
+        countOnes(learnWords.data(), solutions.size(), numWords, size, counts);
+    } else {
+        counts.assign(size, 0);
+        for (unsigned int i = 0; i < solutions.size(); i++) {
+            for (int j = 0; j < size; j++)
+                counts[j] += solutions[i]->at(j);
+        }
+    }
+}
+
+/*
+ Updates the probability vector towards the best solutions by shifting the values of the
+ probVect towards the share of the best solutions with a 1 at that index, then "away from
+ the worst solutions" by shifting the probVect the same way (at a DIFFERENT RATE) in
+ proportion to how much the share of the best and the worst solutions with a 1 differ.
+ With a single best and worst solution, that is a shift towards the best solution where
+ the two differ, as in classic PBIL. Both steps, and the refresh of the sampling
+ thresholds of bit strings, are applied in a single pass, in the configured precision
+ Parameters:
+        posLR: Magnitude shift in the probability vector towards the best solutions
+        negLR: Magnitude shift in the probability vector away from the worst solutions
 */
 void PBIL::updateProbVect(double posLR, double negLR)
 {
-    // Adjusts the value of the probVect towards the best solution at constricted
-    // rate proportional to the positive learning rate
-	for (unsigned int i = 0; i < probVect.size(); i++) {
-		probVect[i] = probVect[i] * (1.0 - posLR) + bestSolution->at(i) * posLR;
-	}
+    countSolutions(bestSolutions, bestOnes);
+    countSolutions(worstSolutions, worstOnes);
+    
+    if (precision == ProbabilityPrecision::fixed32)
+        learnThresholds(posLR, negLR);
+    else if (precision == ProbabilityPrecision::float32)
+        learnProbabilities<float>(floatProbs, posLR, negLR);
+    else
+        learnProbabilities<double>(probVect, posLR, negLR);
+}
 
-    // Adjusts the value of the probVect towards the best solution at a constricted
-    // (different) rate, but only if the best solution and the worst solution are different,
-    // therefore moving the value further away from the worst solution than if it was shared
-    // with the best
-	for (unsigned int i = 0; i < probVect.size(); i++) {
-		if (bestSolution->at(i) != worstSolution->at(i)) {
-			probVect[i] = probVect[i] * (1.0 - negLR) + bestSolution->at(i) * negLR;
-		}
-	}
+/*
+ Applies the learning step of updateProbVect to probabilities held as floating point
+ numbers, writing each bit string sampling threshold as its probability changes
+ Parameters:
+        probs: The probabilities, probVect or its float copy
+        posLR, negLR: The learning rates, as for updateProbVect
+*/
+template <typename Real>
+void PBIL::learnProbabilities(std::vector<Real>& probs, Real posLR, Real negLR)
+{
+    int size = probs.size();
+    Real bestScale = Real(1) / bestSolutions.size();
+    Real worstScale = Real(1) / worstSolutions.size();
+    for (int i = 0; i < size; i++) {
+        Real best = bestOnes[i] * bestScale;
+        Real rate = std::fabs(best - worstOnes[i] * worstScale) * negLR;
+        Real p = probs[i] * (Real(1) - posLR) + best * posLR;
+        p = p * (Real(1) - rate) + best * rate;
+        probs[i] = p;
+        if (sampleBits)
+            bitSampler.setProbability(i, p);
+    }
+}
+
+/*
+ Applies the learning step of updateProbVect straight to the bit string sampling
+ thresholds, as 32-bit fixed-point probabilities, in integer arithmetic. Shares of
+ the best and worst are scaled by 2^32 like the thresholds, and the rates by 2^30,
+ so that no product overflows 64 bits
+ Parameters:
+        posLR, negLR: The learning rates, as for updateProbVect
+*/
+void PBIL::learnThresholds(double posLR, double negLR)
+{
+    const int64_t one = static_cast<int64_t>(1) << 32;
+    int64_t bestStep = one / static_cast<int64_t>(bestSolutions.size());
+    int64_t worstStep = one / static_cast<int64_t>(worstSolutions.size());
+    int64_t pos = std::llround(posLR * (1 << 30));
+    int64_t neg = std::llround(negLR * (1 << 30));
+    
+    int size = probVect.size();
+    for (int i = 0; i < size; i++) {
+        int64_t best = bestOnes[i] * bestStep;
+        int64_t rate = (std::llabs(best - worstOnes[i] * worstStep) * neg) >> 32;
+        int64_t p = bitSampler.getThreshold(i);
+        p += ((best - p) * pos) >> 30;
+        p += ((best - p) * rate) >> 30;
+        bitSampler.setThreshold(i, static_cast<uint32_t>(std::max<int64_t>(0, std::min(p, one - 1))));
+    }
 }
 
 /*
@@ -180,18 +554,34 @@ void PBIL::updateProbVect(double posLR, double negLR)
 */
 void PBIL::mutateProbVect(double mutationProb, double mutationShift)
 {
-	for (unsigned int i = 0; i < probVect.size(); i++) {
-		if ((double)rand() / RAND_MAX < mutationProb) {
-            int mutationDirection = 0;
-            
-			// Mutate the probability at an index so it's never shifted all the way down to 0, or all
-            // the way up to one (both of which would get the generation stuck until it mutated again)
-            if ((double)rand() / RAND_MAX < 0.5)
-                mutationDirection = 1;
-            
+    // Pick the mutated indices by skipping ahead geometrically, rather than
+    // drawing a random number for every index
+    rng.sampleSparse(probVect.size(), mutationProb, mutatedIndices);
+    
+	for (unsigned int j = 0; j < mutatedIndices.size(); j++) {
+        int i = mutatedIndices[j];
+        int mutationDirection = 0;
+        
+        // Mutate the probability at an index so it's never shifted all the way down to 0, or all
+        // the way up to one (both of which would get the generation stuck until it mutated again)
+        if (rng.nextDouble() < 0.5)
+            mutationDirection = 1;
+        
+        if (precision == ProbabilityPrecision::fixed32) {
+            // The same shift in fixed point, as in learnThresholds
+            int64_t one = static_cast<int64_t>(1) << 32;
+            int64_t p = bitSampler.getThreshold(i);
+            p += ((mutationDirection * one - p) * std::llround(mutationShift * (1 << 30))) >> 30;
+            bitSampler.setThreshold(i, static_cast<uint32_t>(std::max<int64_t>(0, std::min(p, one - 1))));
+        } else if (precision == ProbabilityPrecision::float32) {
+            floatProbs[i] = floatProbs[i] * (1.0f - mutationShift) + mutationDirection * mutationShift;
+            bitSampler.setProbability(i, floatProbs[i]);
+        } else {
             probVect[i] = probVect[i] * (1.0 - mutationShift)
                           + mutationDirection * mutationShift;
-		}
+            if (sampleBits)
+                bitSampler.setProbability(i, probVect[i]);
+        }
 	}
 }
 
@@ -202,15 +592,13 @@ void PBIL::mutateProbVect(double mutationProb, double mutationShift)
 */
 void PBIL::printSuccess() const
 {
+    const CNF& reported = preprocessor ? preprocessor->getOriginal() : problem;
     std::cout << std::endl
-              << "For file: " << filepath << std::endl
-              << "With " << probVect.size() << " variables and " << maxSolution << " clauses" << std::endl
-              << "Complete solution found in iteration: " << currIter << std::endl
-              << topEval << " out of " << maxSolution << " clauses satisfied: "
-                         << topEval/maxSolution * 100 << "%" << std::endl
-              << "Assignment: " << std::endl;
+              << "For file: " << reported.getFilepath() << std::endl
+              << "With " << reported.getNumVars() << " variables and " << reported.getNumClauses() << " clauses" << std::endl
+              << "Complete solution found in iteration: " << currIter << std::endl;
     
-    topSolution->print();
+    printSolution();
 }
 
 /*
@@ -220,20 +608,37 @@ void PBIL::printSuccess() const
 */
 void PBIL::printEnd() const
 {
+    const CNF& reported = preprocessor ? preprocessor->getOriginal() : problem;
     std::cout << std::endl
-              << "Iterations Complete." << std::endl
-              << "For file: " << filepath << std::endl
-              << "With " << probVect.size() << " variables and " << maxSolution << " clauses" << std::endl
-              << "Best solution found in iteration: " << topIter << std::endl
-              << topEval << " out of " << maxSolution << " clauses satisfied: "
-                         << topEval/maxSolution * 100 << "%" << std::endl
+              << (stoppedByOther ? shared->stopReason() : "Iterations Complete.") << std::endl
+              << "For file: " << reported.getFilepath() << std::endl
+              << "With " << reported.getNumVars() << " variables and " << reported.getNumClauses() << " clauses" << std::endl
+              << "Best solution found in iteration: " << topIter << std::endl;
+    
+    printSolution();
+}
+
+/*
+ Prints how many clauses the best individual found satisfies, and its assignment. If the
+ problem was preprocessed, both are given in terms of the original problem
+*/
+void PBIL::printSolution() const
+{
+    double fitness = topEval;
+    double clauses = maxSolution;
+    if (preprocessor && topSolution) {
+        fitness = preprocessor->originalFitness(*topSolution);
+        clauses = preprocessor->getOriginal().getNumClauses();
+    }
+    std::cout << fitness << " out of " << clauses << " clauses satisfied: "
+              << fitness/clauses * 100 << "%" << std::endl
               << "Assignment: " << std::endl;
     
     // Only print the individual if there is one, avoids segfaults on 0 generations
-    if (topSolution)
-        topSolution->print();
-    else
+    if (!topSolution)
         std::cout << "No assignment found." << std::endl;
+    else if (preprocessor)
+        preprocessor->print(*topSolution);
+    else
+        topSolution->print();
 }
-
-
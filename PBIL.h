@@ -1,10 +1,15 @@
 #include "Individual.h"
+#include "Preprocessor.h"
+#include "SharedMigration.h"
+#include "BitSampler.h"
+#include "ThreadPool.h"
 
 #include <memory>
 #include <iostream>
 #include <fstream>
 #include <ctime>
 #include <cstdlib>
+#include <cmath>
 #include <utility>
 
 /*
@@ -19,9 +24,22 @@
  
 */
 
+// The number format the probability vector of bit string individuals is learned in:
+// doubles, floats, or the 32-bit fixed-point thresholds they are sampled with
+enum class ProbabilityPrecision { double64, float32, fixed32 };
+
 // A generalized population based incremental learning algorithm that works with abstract Individuals
 class PBIL {
 public:
+    // The run loop compiled for a type of individual, which holds each thread's batch
+    // of individuals by that type so that sampling and evaluation call it directly
+    typedef void (PBIL::*Engine)(std::shared_ptr<Individual> sampleIndividual, int numIndividuals,
+                                 double posLR, double negLR, double mutationProb, double mutationShift,
+                                 int numIter);
+    
+    template <class Ind>
+    static Engine engine() { return &PBIL::run<Ind>; }
+    
 	PBIL(
          int probVectSize,
          std::shared_ptr<Individual> sampleIndividual,
@@ -31,9 +49,20 @@ public:
 		 double mutationProb,
 		 double mutationShift,
 		 int numIter,
-         double maxSolution_);
+         double maxSolution_,
+         const CNF& problem_,
+         int numThreads_ = 1,
+         int batchSize_ = 0,
+         int learnSize_ = 1,
+         uint64_t seed_ = 0,
+         const Preprocessor* preprocessor_ = NULL,
+         SharedMigration* shared_ = NULL,
+         const LocalSearchSettings& localSearch_ = LocalSearchSettings(),
+         ProbabilityPrecision precision_ = ProbabilityPrecision::double64,
+         Engine engine_ = NULL);
 
 private:
+    template <class Ind>
 	void run(std::shared_ptr<Individual> sampleIndividual,
              int numIndividuals,
 			 double posLR,
@@ -44,28 +73,111 @@ private:
 
 	void printSuccess() const;
     void printEnd() const;
+    void printSolution() const;
+    
+    static int chunkBegin(int chunk, int numChunks, int size)
+        { return static_cast<int>(static_cast<long long>(size) * chunk / numChunks); }
     
+    struct Extremes;
+    struct Chunk;
+    void offer(Extremes& extremes, bool best, const Individual& individual, double eval, int position);
+    template <class Ind>
+    void sampleChunk(Chunk& chunk, Ind* const* batch);
 	void findBestAndWorst();
+    void countSolutions(const std::vector<std::shared_ptr<Individual>>& solutions, std::vector<int>& counts);
 	void updateProbVect(double posLR, double NegLR);
+    template <typename Real>
+    void learnProbabilities(std::vector<Real>& probs, Real posLR, Real negLR);
+    void learnThresholds(double posLR, double negLR);
 	void mutateProbVect(double mutationProb, double mutationShift);
 
 	int currIter;
     
     double maxSolution;
     bool success;
+    bool stoppedByOther;
 
-    // The probability vector itself
+    // The problem being solved, used only when printing results, and how it was
+    // simplified from the original problem (if it was)
+    const CNF& problem;
+    const Preprocessor* preprocessor;
+    
+    // Segment shared with other processes working on the same problem (if any), the
+    // individuals migrants are read into, and the newest migrant read so far
+    SharedMigration* shared;
+    std::vector<std::shared_ptr<Individual>> arrivals;
+    uint64_t cursor;
+    
+    // Number of threads to sample and evaluate with, how many individuals each samples
+    // at a time (0 for all of them), how many best and worst individuals to learn from,
+    // and the seed the threads' random streams are split from
+    int numThreads;
+    int batchSize;
+    int learnSize;
+    uint64_t seed;
+    
+    // How the best individual of each iteration is improved by local search, if it is
+    LocalSearchSettings localSearch;
+    
+    // Random stream for mutation and local search, split from the run's seed
+    Random rng;
+
+    // The probability vector itself, and the indices of it mutated last iteration
 	std::vector<double> probVect;
+    std::vector<int> mutatedIndices;
+    
+    // Whether individuals are bit strings, sampled with thresholds kept in step with
+    // probVect, the packed genomes of the best or worst individuals while they are
+    // counted, and how many of the best and of the worst have a 1 at each index
+    bool sampleBits;
+    BitSampler bitSampler;
+    std::vector<uint64_t> learnWords;
+    std::vector<int> bestOnes;
+    std::vector<int> worstOnes;
+    
+    // The number format the probabilities are learned in. With float32 they are kept
+    // in floatProbs and with fixed32 in bitSampler's thresholds, rather than in probVect
+    ProbabilityPrecision precision;
+    std::vector<float> floatProbs;
+    
+    // Copies of the best (or worst) individuals sampled so far in an iteration, with
+    // their fitness and their position among the iteration's individuals, and which
+    // of them would be replaced first
+    struct Extremes {
+        std::vector<std::shared_ptr<Individual>> individuals;
+        std::vector<double> evals;
+        std::vector<int> positions;
+        int size;
+        int weakest;
+    };
+    
+    // One thread's share of each iteration's individuals: where it starts and how many
+    // it samples, the batch of individuals it samples them into (the whole share unless
+    // batchSize is set) along with their evaluations, their ranking and, for bit
+    // strings, the buffer they are drawn into, and the best and worst it has sampled
+    struct Chunk {
+        int first;
+        int count;
+        std::vector<std::shared_ptr<Individual>> batch;
+        std::vector<double> evaluations;
+        std::vector<int> order;
+        std::vector<uint64_t> samples;
+        Extremes best;
+        Extremes worst;
+        std::unique_ptr<Random> rng;
+    };
+    std::vector<Chunk> chunks;
     
-    // The evaluations and the actual population of individuals
-	std::vector<double> evaluations;
-    std::vector<std::shared_ptr<Individual>> population;
+    // The chunk and index within it of every chunk's best (or worst) individuals
+    // while they are ranked together, kept between iterations to reuse its storage
+    std::vector<std::pair<int, int>> candidates;
     
-    // Best and worst individuals of a given generation
-	std::shared_ptr<Individual> bestSolution;
-	std::shared_ptr<Individual> worstSolution;
-    int bestEvalIndex;
-	int worstEvalIndex;
+    // Best and worst individuals of a given generation, best and worst first, and the
+    // fitness of the very best and worst
+    std::vector<std::shared_ptr<Individual>> bestSolutions;
+    std::vector<std::shared_ptr<Individual>> worstSolutions;
+    double bestEval;
+    double worstEval;
 
     // Best ever individual, and when it occured
     std::shared_ptr<Individual> topSolution;
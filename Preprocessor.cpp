@@ -0,0 +1,353 @@
+#include "Preprocessor.h"
+
+#include <algorithm>
+
+/*
+
+ ****************************
+ *       Preprocessor       *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+
+ This file contains code to simplify a MAXSAT problem before an algorithm is run on it,
+ so that every evaluation of every individual scans fewer clauses and variables.
+ Variables whose best value is forced are fixed and dropped from the genome, as are
+ variables left in no clause, and clauses whose outcome no longer depends on the free
+ variables are dropped from the clause set. Assignments found for the simplified
+ problem are translated back to the original variables to be printed and checked.
+
+ Tautologies (clauses containing a variable and its negation) and pure literals
+ (literals whose negation appears in no clause) can always be removed without changing
+ the best number of satisfied clauses, so they make up the maxsat level. The sat level
+ adds unit propagation and the removal of duplicate and subsumed clauses. Those keep
+ any complete solution complete, but may change which partial solutions are best, so
+ reported fitness is always recounted against the original problem.
+
+*/
+
+/*
+ Simplifies a problem
+ Parameters:
+        original_: The problem to simplify, which must outlive the Preprocessor
+        simplified: An empty CNF to store the simplified problem in
+        level: Which simplifications to apply
+*/
+Preprocessor::Preprocessor(const CNF& original_, CNF& simplified, PreprocessLevel level)
+    : original(original_), fixedValue(original_.getNumVars(), -1), simplifiedIndex(original_.getNumVars(), -1),
+      numTautologies(0), numSubsumed(0), numUnits(0), numPure(0), numSimplifiedVars(0), numSimplifiedClauses(0)
+{
+    normalizeClauses(level != PreprocessLevel::none);
+
+    if (level == PreprocessLevel::sat) {
+        // Unit propagation assumes every clause can be satisfied. When it finds that
+        // they cannot, the problem is a true MAXSAT instance and the units are undone
+        std::vector<std::vector<unsigned int>> savedClauses(clauses);
+        std::vector<char> savedRemoved(removed);
+        if (!propagateUnits()) {
+            clauses.swap(savedClauses);
+            removed.swap(savedRemoved);
+            fixedValue.assign(original.getNumVars(), -1);
+            numUnits = 0;
+        }
+        eliminateSubsumed();
+    }
+    if (level != PreprocessLevel::none)
+        eliminatePureLiterals();
+
+    buildSimplified(simplified);
+
+    // The working copy is only needed while simplifying
+    std::vector<std::vector<unsigned int>>().swap(clauses);
+    std::vector<char>().swap(removed);
+}
+
+/*
+ Fixes a variable so that a literal is true
+ Parameters:
+        lit: The encoded literal to make true
+*/
+void Preprocessor::assign(unsigned int lit)
+{
+    fixedValue[CNF::literalVar(lit)] = CNF::literalNegated(lit) ? 0 : 1;
+}
+
+/*
+ Copies the clauses of the original problem with their literals sorted and repeated
+ literals dropped
+ Parameters:
+        removeTautologies: Whether to remove tautologies (which any assignment satisfies)
+*/
+void Preprocessor::normalizeClauses(bool removeTautologies)
+{
+    clauses.resize(original.getNumClauses());
+    removed.assign(original.getNumClauses(), 0);
+    for (int c = 0; c < original.getNumClauses(); c++) {
+        std::vector<unsigned int>& clause = clauses[c];
+        clause.assign(original.clauseBegin(c), original.clauseEnd(c));
+        std::sort(clause.begin(), clause.end());
+        clause.erase(std::unique(clause.begin(), clause.end()), clause.end());
+
+        // A literal and its negation differ only in the sign bit, so they are
+        // adjacent once sorted
+        for (unsigned int i = 1; removeTautologies && i < clause.size(); i++) {
+            if ((clause[i] ^ clause[i - 1]) == 1) {
+                removed[c] = 1;
+                numTautologies++;
+                break;
+            }
+        }
+    }
+}
+
+/*
+ Repeatedly fixes the variables of single literal clauses, removing the clauses they
+ satisfy and the literals they falsify
+ Returns false if a clause lost all of its literals (or two units conflicted), in which
+ case the clauses are left partly simplified and must be restored by the caller
+*/
+bool Preprocessor::propagateUnits()
+{
+    std::vector<std::vector<int>> occurs(2 * original.getNumVars());
+    std::vector<unsigned int> queue;
+    for (unsigned int c = 0; c < clauses.size(); c++) {
+        if (removed[c]) continue;
+        for (unsigned int i = 0; i < clauses[c].size(); i++)
+            occurs[clauses[c][i]].push_back(c);
+        if (clauses[c].size() == 1)
+            queue.push_back(clauses[c][0]);
+    }
+
+    for (unsigned int q = 0; q < queue.size(); q++) {
+        unsigned int lit = queue[q];
+        int var = CNF::literalVar(lit);
+        if (fixedValue[var] >= 0) {
+            if (fixedValue[var] != (CNF::literalNegated(lit) ? 0 : 1))
+                return false;
+            continue;
+        }
+        assign(lit);
+        numUnits++;
+
+        // Clauses containing the literal are satisfied
+        for (unsigned int i = 0; i < occurs[lit].size(); i++)
+            removed[occurs[lit][i]] = 1;
+
+        // Clauses containing its negation lose that literal
+        for (unsigned int i = 0; i < occurs[lit ^ 1].size(); i++) {
+            int c = occurs[lit ^ 1][i];
+            if (removed[c]) continue;
+            std::vector<unsigned int>& clause = clauses[c];
+            clause.erase(std::find(clause.begin(), clause.end(), lit ^ 1));
+            if (clause.empty())
+                return false;
+            if (clause.size() == 1)
+                queue.push_back(clause[0]);
+        }
+    }
+    return true;
+}
+
+/*
+ Removes clauses that contain every literal of some other clause (including exact
+ duplicates), since satisfying the smaller clause satisfies them too. Clauses are
+ visited smallest first, and each is checked only against the clauses sharing its
+ rarest literal
+*/
+void Preprocessor::eliminateSubsumed()
+{
+    std::vector<std::vector<int>> occurs(2 * original.getNumVars());
+    std::vector<int> order;
+    for (unsigned int c = 0; c < clauses.size(); c++) {
+        if (removed[c]) continue;
+        order.push_back(c);
+        for (unsigned int i = 0; i < clauses[c].size(); i++)
+            occurs[clauses[c][i]].push_back(c);
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [this](int a, int b) { return clauses[a].size() < clauses[b].size(); });
+
+    for (unsigned int k = 0; k < order.size(); k++) {
+        int c = order[k];
+        if (removed[c]) continue;
+        const std::vector<unsigned int>& clause = clauses[c];
+
+        unsigned int rarest = clause[0];
+        for (unsigned int i = 1; i < clause.size(); i++) {
+            if (occurs[clause[i]].size() < occurs[rarest].size())
+                rarest = clause[i];
+        }
+
+        // Both clauses are sorted, so containment is a single merge
+        const std::vector<int>& candidates = occurs[rarest];
+        for (unsigned int i = 0; i < candidates.size(); i++) {
+            int d = candidates[i];
+            if (d == c || removed[d] || clauses[d].size() < clause.size())
+                continue;
+            if (std::includes(clauses[d].begin(), clauses[d].end(), clause.begin(), clause.end())) {
+                removed[d] = 1;
+                numSubsumed++;
+            }
+        }
+    }
+}
+
+/*
+ Repeatedly fixes variables that appear with only one sign, which satisfies every clause
+ they appear in without falsifying any. Removing those clauses can make further literals
+ pure, so counts are kept per literal and updated as clauses go
+*/
+void Preprocessor::eliminatePureLiterals()
+{
+    std::vector<std::vector<int>> occurs(2 * original.getNumVars());
+    std::vector<int> counts(2 * original.getNumVars(), 0);
+    for (unsigned int c = 0; c < clauses.size(); c++) {
+        if (removed[c]) continue;
+        for (unsigned int i = 0; i < clauses[c].size(); i++) {
+            occurs[clauses[c][i]].push_back(c);
+            counts[clauses[c][i]]++;
+        }
+    }
+
+    std::vector<unsigned int> queue;
+    for (unsigned int lit = 0; lit < counts.size(); lit++) {
+        if (counts[lit] > 0 && counts[lit ^ 1] == 0)
+            queue.push_back(lit);
+    }
+
+    for (unsigned int q = 0; q < queue.size(); q++) {
+        unsigned int lit = queue[q];
+        if (fixedValue[CNF::literalVar(lit)] >= 0)
+            continue;
+        assign(lit);
+        numPure++;
+
+        for (unsigned int i = 0; i < occurs[lit].size(); i++) {
+            int c = occurs[lit][i];
+            if (removed[c]) continue;
+            removed[c] = 1;
+            for (unsigned int j = 0; j < clauses[c].size(); j++) {
+                unsigned int other = clauses[c][j];
+                if (--counts[other] == 0 && counts[other ^ 1] > 0)
+                    queue.push_back(other ^ 1);
+            }
+        }
+    }
+}
+
+/*
+ Renumbers the variables still appearing in the remaining clauses (keeping their
+ order), and stores the remaining clauses over them
+ Parameters:
+        simplified: The CNF to fill
+*/
+void Preprocessor::buildSimplified(CNF& simplified)
+{
+    size_t numLiterals = 0;
+    for (unsigned int c = 0; c < clauses.size(); c++) {
+        if (removed[c]) continue;
+        numSimplifiedClauses++;
+        numLiterals += clauses[c].size();
+        for (unsigned int i = 0; i < clauses[c].size(); i++)
+            simplifiedIndex[CNF::literalVar(clauses[c][i])] = 0;
+    }
+    for (int v = 0; v < original.getNumVars(); v++) {
+        if (simplifiedIndex[v] == 0 && fixedValue[v] < 0)
+            simplifiedIndex[v] = numSimplifiedVars++;
+        else
+            simplifiedIndex[v] = -1;
+    }
+
+    simplified.filepath = original.getFilepath();
+    simplified.literals.reserve(numLiterals);
+    simplified.offsets.reserve(numSimplifiedClauses + 1);
+    for (unsigned int c = 0; c < clauses.size(); c++) {
+        if (removed[c]) continue;
+        for (unsigned int i = 0; i < clauses[c].size(); i++) {
+            unsigned int lit = clauses[c][i];
+            simplified.literals.push_back((static_cast<unsigned int>(simplifiedIndex[CNF::literalVar(lit)]) << 1) | (lit & 1));
+        }
+        simplified.offsets.push_back(simplified.literals.size());
+    }
+    simplified.numVars = numSimplifiedVars;
+    simplified.attachOwned();
+    simplified.buildOccurrences();
+}
+
+/*
+ Translates an assignment of the simplified problem into one of the original problem.
+ Fixed variables take their fixed value, and variables that were left in no clause are 0
+ Parameters:
+        individual: An individual of the simplified problem
+        assignment: Output, the value (0 or 1) of each original variable
+*/
+void Preprocessor::restore(const Individual& individual, std::vector<char>& assignment) const
+{
+    assignment.assign(original.getNumVars(), 0);
+    for (int v = 0; v < original.getNumVars(); v++) {
+        if (fixedValue[v] >= 0)
+            assignment[v] = fixedValue[v];
+        else if (simplifiedIndex[v] >= 0)
+            assignment[v] = individual.at(simplifiedIndex[v]);
+    }
+}
+
+/*
+ Counts the clauses of the original problem satisfied by an assignment
+ Parameters:
+        assignment: The value (0 or 1) of each original variable
+ Returns the number of satisfied clauses
+*/
+int Preprocessor::countSatisfied(const std::vector<char>& assignment) const
+{
+    int satisfied = 0;
+    for (int c = 0; c < original.getNumClauses(); c++) {
+        for (const unsigned int* lit = original.clauseBegin(c); lit != original.clauseEnd(c); ++lit) {
+            if (assignment[CNF::literalVar(*lit)] != static_cast<char>(CNF::literalNegated(*lit))) {
+                satisfied++;
+                break;
+            }
+        }
+    }
+    return satisfied;
+}
+
+/*
+ Counts the clauses of the original problem satisfied by an individual of the simplified one
+ Parameters:
+        individual: An individual of the simplified problem
+ Returns the number of satisfied original clauses
+*/
+int Preprocessor::originalFitness(const Individual& individual) const
+{
+    std::vector<char> assignment;
+    restore(individual, assignment);
+    return countSatisfied(assignment);
+}
+
+/*
+ Prints an individual of the simplified problem as an assignment of the original
+ variables, in the same form as MAXSATIndividual::print
+ Parameters:
+        individual: An individual of the simplified problem
+*/
+void Preprocessor::print(const Individual& individual) const
+{
+    std::vector<char> assignment;
+    restore(individual, assignment);
+    for (unsigned int i = 0; i < assignment.size(); i++)
+        std::cout << static_cast<int>(assignment[i]);
+    std::cout << std::endl;
+}
+
+/*
+ Prints how much the problem shrank and why
+*/
+void Preprocessor::printSummary() const
+{
+    std::cout << "Preprocessing: " << original.getNumVars() << " -> " << numSimplifiedVars << " variables, "
+              << original.getNumClauses() << " -> " << numSimplifiedClauses << " clauses ("
+              << numUnits << " unit and " << numPure << " pure literals fixed, "
+              << numTautologies << " tautologies and " << numSubsumed << " subsumed clauses removed)"
+              << std::endl;
+}
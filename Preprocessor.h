@@ -0,0 +1,78 @@
+#pragma once
+
+#include "readCNF.h"
+#include "Individual.h"
+
+#include <vector>
+#include <string>
+
+/*
+
+ ****************************
+ *       Preprocessor       *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+
+ See Preprocessor.cpp for more documentation.
+
+*/
+
+// How aggressively to simplify a problem before running an algorithm on it.
+// none runs on the problem as read (main builds no Preprocessor for it), maxsat applies
+// steps that keep the best possible number of satisfied clauses, and sat also applies
+// steps that only keep whether every clause can be satisfied
+enum class PreprocessLevel { none, maxsat, sat };
+
+// Simplifies a CNF into a smaller one over the variables that are still free, and
+// maps assignments of the simplified problem back to the original variables.
+// Class and method documentation can be found in Preprocessor.cpp
+class Preprocessor {
+public:
+    Preprocessor(const CNF& original_, CNF& simplified, PreprocessLevel level);
+
+    // Translates an assignment of the simplified problem into one of the original
+    // problem (a 0 or 1 per original variable)
+    void restore(const Individual& individual, std::vector<char>& assignment) const;
+
+    // Number of original clauses satisfied by an assignment of the original variables
+    int countSatisfied(const std::vector<char>& assignment) const;
+
+    // Number of original clauses satisfied by an individual of the simplified problem
+    int originalFitness(const Individual& individual) const;
+
+    // Prints an individual of the simplified problem as an assignment of the original
+    void print(const Individual& individual) const;
+
+    // Prints a one line summary of how much the problem shrank
+    void printSummary() const;
+
+    const CNF& getOriginal() const { return original; }
+
+private:
+    void assign(unsigned int lit);
+    void normalizeClauses(bool removeTautologies);
+    bool propagateUnits();
+    void eliminateSubsumed();
+    void eliminatePureLiterals();
+    void buildSimplified(CNF& simplified);
+
+    const CNF& original;
+
+    // Working copy of the clauses during simplification, and which were removed
+    std::vector<std::vector<unsigned int>> clauses;
+    std::vector<char> removed;
+
+    // Value fixed for each original variable (-1 while free), and the index of each
+    // variable still free in the simplified problem (-1 for fixed variables)
+    std::vector<signed char> fixedValue;
+    std::vector<int> simplifiedIndex;
+
+    // Counts of what was removed, for the summary
+    int numTautologies;
+    int numSubsumed;
+    int numUnits;
+    int numPure;
+    int numSimplifiedVars;
+    int numSimplifiedClauses;
+};
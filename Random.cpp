@@ -0,0 +1,110 @@
+#include "Random.h"
+
+#include <cmath>
+
+/*
+ 
+ ****************************
+ *          Random          *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+ 
+ The Random class contains code for an independent stream of random numbers, used
+ in place of the global rand() so that threads of the algorithms can draw random
+ numbers without sharing state, and so that a seeded run can be replayed. The
+ generator is xoshiro256++ (Blackman and Vigna), which is much faster than rand(),
+ gives 64 bits per call, and can jump ahead 2^128 steps to split off streams.
+ 
+*/
+
+/*
+ Constructs a random stream
+ Parameters:
+        seed: Seed for the run. The generator state is expanded from it with splitmix64
+        stream: Index of the stream for this seed (e.g. the thread index)
+*/
+Random::Random(uint64_t seed, int stream)
+{
+    uint64_t x = seed;
+    for (int i = 0; i < 4; i++) {
+        uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        state[i] = z ^ (z >> 31);
+    }
+    
+    for (int i = 0; i < stream; i++)
+        jump();
+}
+
+/*
+ Advances the generator by 2^128 steps, the start of the next stream
+*/
+void Random::jump()
+{
+    static const uint64_t JUMP[] = { 0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL,
+                                     0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL };
+    
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (JUMP[i] & (static_cast<uint64_t>(1) << b)) {
+                s0 ^= state[0];
+                s1 ^= state[1];
+                s2 ^= state[2];
+                s3 ^= state[3];
+            }
+            nextWord();
+        }
+    }
+    state[0] = s0;
+    state[1] = s1;
+    state[2] = s2;
+    state[3] = s3;
+}
+
+/*
+ Samples the positions picked by independent Bernoulli trials without running every
+ trial. The gap before the next picked position is geometrically distributed, so it
+ is drawn directly by inverting the geometric distribution, floor(log(U) / log(1 - p)),
+ and the scan skips ahead by that much. One random number is drawn per position
+ picked (plus one to step past the end), so sparse mutation is cheap on long genomes.
+ Parameters:
+        length: Number of positions to choose from
+        prob: Probability that any given position is picked
+        positions: Output, cleared and then filled with the picked positions in order
+*/
+void Random::sampleSparse(int length, double prob, std::vector<int>& positions)
+{
+    positions.clear();
+    if (prob <= 0.0 || length <= 0)
+        return;
+    if (prob >= 1.0) {
+        for (int i = 0; i < length; i++)
+            positions.push_back(i);
+        return;
+    }
+    
+    double logSkip = 1.0 / std::log1p(-prob);
+    double next = -1.0;
+    while (true) {
+        // 1 - nextDouble() lies in (0, 1], so the log is finite
+        next += 1.0 + std::floor(std::log(1.0 - nextDouble()) * logSkip);
+        if (next >= length)
+            return;
+        positions.push_back(static_cast<int>(next));
+    }
+}
+
+/*
+ Fills an array with random words
+ Parameters:
+        out: The array to fill
+        count: Number of words to write
+*/
+void Random::fillWords(uint64_t* out, int count)
+{
+    for (int i = 0; i < count; i++)
+        out[i] = nextWord();
+}
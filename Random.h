@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/*
+ 
+ ****************************
+ *          Random          *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+ 
+ See Random.cpp for more documentation.
+ 
+*/
+
+// A random number stream, using the xoshiro256++ generator. Each thread of an
+// algorithm owns its own stream, so no locking is needed. All the streams of a run
+// come from a single seed: stream k starts 2^128 * k steps into the sequence for
+// that seed, so streams never overlap and a run is reproducible from its seed for
+// a given number of threads.
+class Random {
+public:
+    explicit Random(uint64_t seed, int stream = 0);
+    
+    // 64 random bits
+    uint64_t nextWord()
+    {
+        uint64_t result = rotate(state[0] + state[3], 23) + state[0];
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotate(state[3], 45);
+        return result;
+    }
+    
+    // Uniform double in [0, 1)
+    double nextDouble() { return (nextWord() >> 11) * (1.0 / 9007199254740992.0); }
+    
+    // Uniform integer in [0, n)
+    int nextInt(int n) { return static_cast<int>((static_cast<unsigned __int128>(nextWord()) * n) >> 64); }
+    
+    // The positions in [0, length) chosen when each is picked independently with
+    // probability prob, in increasing order. Costs time proportional to the number
+    // of positions picked rather than to length
+    void sampleSparse(int length, double prob, std::vector<int>& positions);
+    
+    // Fills count entries of out with random words
+    void fillWords(uint64_t* out, int count);
+
+private:
+    static uint64_t rotate(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+    void jump();
+    
+    uint64_t state[4];
+};
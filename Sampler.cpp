@@ -1,5 +1,7 @@
 #include "Sampler.h"
 
+#include <algorithm>
+
 /*
  
  ****************************
@@ -23,122 +25,167 @@
         method_: Parsed info indentified which of the implemented selection methods will be used
         population_: Reference to the vector of pointers to abstract individuals
         evaluations_: Reference to the vector of fitness evaluations of the population
+        temperature_: Temperature for boltzmann selection
 */
 Sampler::Sampler(SelectionMethod method_,
                    const std::vector<std::shared_ptr<Individual>>& population_,
-                   const std::vector<double>& evaluations_)
-    : method(method_), population(population_), evaluations(evaluations_), sum(0)
+                   const std::vector<double>& evaluations_,
+                   double temperature_)
+    : method(method_), population(population_), evaluations(evaluations_), temperature(temperature_)
+{
+    update();
+}
+
+/*
+ Prepares the sampler for the current contents of the population and evaluations, which
+ must be called whenever they change (e.g. once per generation). The buffers are reused,
+ so repeated updates of an equally sized population do not reallocate them
+*/
+void Sampler::update()
 {
-    // In preparation for boltzman, sum the values of e^fitness for the denominator
+    // In preparation for boltzman, weight each individual by e^(fitness / T). The
+    // largest fitness is subtracted first (the log-sum-exp trick), which leaves the
+    // probabilities unchanged but keeps e^x from overflowing on large fitnesses
     if (method == SelectionMethod::boltzmann) {
+        double maxFitness = -HUGE_VAL;
+        for (unsigned int i = 0; i < evaluations.size(); i++)
+            maxFitness = std::max(maxFitness, evaluations[i]);
+        
+        weights.resize(evaluations.size());
         for (unsigned int i = 0; i < evaluations.size(); i++)
-            sum += exp(evaluations[i]);
+            weights[i] = exp((evaluations[i] - maxFitness) / temperature);
+        
+        buildAliasTable();
     }
     
-    // In preparation for rank selection, hash the individuals and their ranks
+    // In preparation for rank selection, order the individuals by fitness and
+    // weight them by their ranks
     else if (method == SelectionMethod::ranking) {
-        // Key: fitness, value: vector of individuals (in case individuals have equal fitnesses)
-        // store map in descending order of keys
-        rankSum = 0; // sum the ranks of the individuals
+        rankOrder();
         
-        for (unsigned int i = 0; i < population.size(); i++) {
-            double fitness = evaluations[i];
-            
-            // If fitness not equal to any other, add individual to map
-            if (ranks[fitness].size() == 0) {
-                std::vector<std::shared_ptr<Individual>> rankVector;
-                rankVector.push_back(population[i]);
-                ranks[fitness] = rankVector;
-            }
-            
-            // Else add individual to existing vector in map
-            else {
-                ranks[fitness].push_back(population[i]);
-            }
-            rankSum += i;
-        }
+        // The best individual gets rank N and the worst rank 1
+        weights.resize(order.size());
+        for (unsigned int i = 0; i < order.size(); i++)
+            weights[order[i]] = order.size() - i;
+        
+        buildAliasTable();
     }
 }
 
 /*
- Runs the selection method passed to the constructor on the population of individuals,
- see Sampler.h for selection method information
- Returns a pointer to a selected individual
+ Fills order with the indices of the individuals from highest to lowest fitness, ties
+ in population order. Fitnesses that are all integers in a range no wider than a few
+ times the population (like clause counts) are counting sorted in linear time;
+ anything else falls back to a comparison sort. Either way the buffers are reused
 */
-std::shared_ptr<Individual> Sampler::select() const
+void Sampler::rankOrder()
 {
-
-    if (method == SelectionMethod::boltzmann) {
-        
-        double random = static_cast<double>(rand()) / RAND_MAX;
-        double missed = 0;
-        
-        // Not an off by one error, see NOTE below
-        for (unsigned int i = 0; i < evaluations.size() - 1; i++) {
-            double prob = exp(evaluations[i]) / sum;
-            
-            // Runs in linear time, rather than assessing the probability of
-            // each one in two loops, add the chance to skip the previous ones
-            // to the chance to get the select the current one
-            if (random <= prob + missed)
-                return population[i]->clone();
-            missed += prob;
-        }
-        
-        // NOTE Although all the probabilites should sum to 1, they may not
-        //      since we are doing floating point math. If the random number is
-        //      also particulary large, no selection would be made. In this case,
-        //      we return the last Individual in the population.
-        return population[population.size() - 1]->clone();
+    int n = evaluations.size();
+    order.resize(n);
+    if (n == 0)
+        return;
+    
+    double minFitness = evaluations[0];
+    double maxFitness = evaluations[0];
+    bool integral = true;
+    for (int i = 0; i < n; i++) {
+        minFitness = std::min(minFitness, evaluations[i]);
+        maxFitness = std::max(maxFitness, evaluations[i]);
+        integral = integral && evaluations[i] == std::floor(evaluations[i]);
     }
     
-    if (method == SelectionMethod::ranking) {
-        double random = static_cast<double>(rand()) / RAND_MAX;
-        
-        int count = 0; // count of number of individuals checked so far
-        double missed = 0;
+    if (integral && maxFitness - minFitness < 4.0 * n + 1024) {
+        // Count each fitness, bucket 0 holding the highest, then turn the counts into
+        // the position where each bucket starts and place the individuals in order
+        int numBuckets = static_cast<int>(maxFitness - minFitness) + 1;
+        buckets.assign(numBuckets, 0);
+        for (int i = 0; i < n; i++)
+            buckets[static_cast<int>(maxFitness - evaluations[i])]++;
         
-        // Iterate through the map in descending order of keys
-        for (std::map<double, std::vector<std::shared_ptr<Individual>>, std::greater<double>>::const_iterator it = ranks.begin(); it != ranks.end(); ++it) {
-            // For all individuals that have same key (fitness)
-            for (unsigned int i = 0; i < it->second.size(); i++) {
-                double prob = static_cast<double>(population.size() - count)/rankSum;
-                if (random <= prob + missed) {
-                    return it->second[i];
-                }
-                
-                missed += prob;
-                count++;
-            }
+        int start = 0;
+        for (int b = 0; b < numBuckets; b++) {
+            int count = buckets[b];
+            buckets[b] = start;
+            start += count;
         }
         
-        // see NOTE above -- return the last Individual in the population
-        return population[population.size() - 1];
+        for (int i = 0; i < n; i++)
+            order[buckets[static_cast<int>(maxFitness - evaluations[i])]++] = i;
+    } else {
+        for (int i = 0; i < n; i++)
+            order[i] = i;
+        const std::vector<double>& fitness = evaluations;
+        std::stable_sort(order.begin(), order.end(),
+                         [&fitness](int a, int b) { return fitness[a] > fitness[b]; });
     }
+}
+
+/*
+ Builds the alias table for the current weights with Vose's method. Each weight is
+ scaled so that the average is 1; slots with less than 1 are topped up by an alias
+ with more than 1, until every slot holds exactly 1 unit of probability
+*/
+void Sampler::buildAliasTable()
+{
+    int n = weights.size();
+    aliasProb.resize(n);
+    alias.resize(n);
+    small.clear();
+    large.clear();
     
-    if (method == SelectionMethod::tournament) {
-        // select two random Individuals from population
-        int random1 = static_cast<int>(rand() % population.size());
-        int random2 = static_cast<int>(rand() % population.size());
-        
-        double fitness1 = evaluations[random1];
-        double fitness2 = evaluations[random2];
+    double total = 0.0;
+    for (int i = 0; i < n; i++)
+        total += weights[i];
+    
+    for (int i = 0; i < n; i++) {
+        aliasProb[i] = weights[i] * n / total;
+        alias[i] = i;
+        if (aliasProb[i] < 1.0)
+            small.push_back(i);
+        else
+            large.push_back(i);
+    }
+    
+    while (!small.empty() && !large.empty()) {
+        int less = small.back();
+        int more = large.back();
+        small.pop_back();
         
-        if (fitness1 > fitness2) {
-            return population[random1];
-        }
-        else if (fitness1 < fitness2) {
-            return population[random2];
+        // The small slot is filled up by the large one, which loses that much
+        alias[less] = more;
+        aliasProb[more] -= 1.0 - aliasProb[less];
+        if (aliasProb[more] < 1.0) {
+            large.pop_back();
+            small.push_back(more);
         }
-        
-        // fitnesses are equal, choose individual randomly
-        if (static_cast<double>(rand()) / RAND_MAX < 0.5)
-            return population[random1];
-        
-        return population[random2];
     }
     
+    // NOTE Whatever is left over is 1 up to floating point error
+    for (unsigned int i = 0; i < small.size(); i++)
+        aliasProb[small[i]] = 1.0;
+    for (unsigned int i = 0; i < large.size(); i++)
+        aliasProb[large[i]] = 1.0;
+}
+
+/*
+ Runs the selection method passed to the constructor on the population of individuals,
+ see Sampler.h for selection method information. Only reads the sampler's state, so
+ threads may select concurrently as long as each uses its own random stream
+ Parameters:
+        rng: Random stream to draw the selection from
+ Returns the index of a selected individual in the population. The individual
+ itself is not copied; callers copy it into the next generation as needed
+*/
+int Sampler::select(Random& rng) const
+{
+    if (method == SelectionMethod::boltzmann)
+        return select<SelectionMethod::boltzmann>(rng);
+    if (method == SelectionMethod::ranking)
+        return select<SelectionMethod::ranking>(rng);
+    if (method == SelectionMethod::tournament)
+        return select<SelectionMethod::tournament>(rng);
+    
     // Return an error if the selection method was wrong
     std::cout << "SelectionMethod choice failed." << std::endl;
-    return std::shared_ptr<Individual>(NULL);
+    return -1;
 }
@@ -6,7 +6,7 @@
 #include <memory>
 #include <cstdlib>
 #include <cmath>
-#include <map>
+#include <algorithm>
 
 /*
  
@@ -23,7 +23,7 @@
 enum class SelectionMethod { ranking, tournament, boltzmann };
 
 /* Class for sampling from a population given a selection method
- (1) SelectionMethod::ranking - Rank selection ranks the individuals (here hashed by rank in the constructor),
+ (1) SelectionMethod::ranking - Rank selection ranks the individuals (here ordered by fitness in update),
                                  from lowest (1) to highest (N), then selects with probability [rank[i] / sum(ranks[i])
  
  (2) SelectionMethod::tournament - randomly selects M individuals, and passes
@@ -31,27 +31,90 @@ enum class SelectionMethod { ranking, tournament, boltzmann };
                                     each tournament selects the best k = 1 of M = 2 individuals, returning
                                     both to the population for possible future selection
  
- (3) SelectionMethod::boltzmann - selects an individual with probability[e^fitness[i] / sum(e^fitnesses[i])]
-                                    (here the sum of the ranks occurs in the constructor)
+ (3) SelectionMethod::boltzmann - selects an individual with probability[e^(fitness[i]/T) / sum(e^(fitnesses[i]/T))]
+                                    for a temperature T (1 by default)
+ 
+ Ranking and Boltzmann selection build a Walker/Vose alias table of the selection
+ probabilities once per generation (in update), so each select() is O(1).
  
  Class and method documentation can be found in Sampler.cpp
 */
 class Sampler {
 public:
-    Sampler(SelectionMethod method_, const std::vector<std::shared_ptr<Individual>>& population_, const std::vector<double>& evaluations_);
-    std::shared_ptr<Individual> select() const;
+    Sampler(SelectionMethod method_, const std::vector<std::shared_ptr<Individual>>& population_,
+            const std::vector<double>& evaluations_, double temperature_ = 1.0);
+    
+    void update();
+    int select(Random& rng) const;
+    
+    // Like select, but for a selection method fixed at compile time (which must be the
+    // sampler's), so callers that select in a loop don't test the method every call
+    template <SelectionMethod fixed>
+    int select(Random& rng) const;
 
 private:
+    void rankOrder();
+    void buildAliasTable();
+    
     SelectionMethod method;
     
     // References to the population and its fitness evaluations
     const std::vector<std::shared_ptr<Individual>>& population;
     const std::vector<double>& evaluations;
     
-    // A hashtable to store individuals by fitness rank for ranking selection, and its iterator
-    std::map<double, std::vector<std::shared_ptr<Individual>>, std::greater<double>> ranks;
-    int rankSum;
+    // Temperature for boltzmann selection (higher is closer to uniform)
+    double temperature;
     
-    // Value of the exponential sum of fitnesses for boltzmann selection
-    double sum;
+    // Indices of the individuals from highest to lowest fitness for ranking selection,
+    // and the bucket positions used to counting sort integer fitnesses into it
+    std::vector<int> order;
+    std::vector<int> buckets;
+    
+    // Selection weight of every individual, and the alias table built from them:
+    // slot i is picked uniformly, then individual i is selected with probability
+    // aliasProb[i] and individual alias[i] otherwise
+    std::vector<double> weights;
+    std::vector<double> aliasProb;
+    std::vector<int> alias;
+    
+    // Worklists used while building the alias table
+    std::vector<int> small;
+    std::vector<int> large;
 };
+
+/*
+ Runs a selection method known at compile time, which must be the one passed to the
+ constructor (see select in Sampler.cpp)
+ Parameters:
+        rng: Random stream to draw the selection from
+ Returns the index of a selected individual in the population
+*/
+template <SelectionMethod fixed>
+inline int Sampler::select(Random& rng) const
+{
+    // Ranking and boltzmann both sample from the alias table in constant time
+    if (fixed == SelectionMethod::boltzmann || fixed == SelectionMethod::ranking) {
+        int slot = rng.nextInt(aliasProb.size());
+        return rng.nextDouble() < aliasProb[slot] ? slot : alias[slot];
+    }
+    
+    // select two random Individuals from population
+    int random1 = rng.nextInt(population.size());
+    int random2 = rng.nextInt(population.size());
+    
+    double fitness1 = evaluations[random1];
+    double fitness2 = evaluations[random2];
+    
+    if (fitness1 > fitness2) {
+        return random1;
+    }
+    else if (fitness1 < fitness2) {
+        return random2;
+    }
+    
+    // fitnesses are equal, choose individual randomly
+    if (rng.nextDouble() < 0.5)
+        return random1;
+    
+    return random2;
+}
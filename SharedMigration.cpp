@@ -0,0 +1,502 @@
+#include "SharedMigration.h"
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+
+ ****************************
+ *     SharedMigration      *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+
+ The SharedMigration class lets separate ga processes (running the GA or PBIL) cooperate
+ on one problem through a named POSIX shared memory segment, with no network needed.
+ The first process to start creates the segment, later ones attach to it, and the last
+ one to finish removes it. Every attached process holds a lease in the segment, renewed
+ every second by a background thread, so a process killed without detaching loses its
+ lease a few seconds later. A process that finds no live lease but its own when it
+ attaches resets the segment (its stop flag, best individual and migrants) left behind
+ by a crash, and the last live process removes it when it finishes.
+
+ The segment is laid out as a header, the leases, the slot holding the best individual
+ found by any process, and a ring of migrant slots that processes publish into in turn. Each slot is
+ a sequence lock: its stamp is odd while a writer holds it and even otherwise, writers
+ claim a slot by swapping its stamp from even to odd (and give up if another writer
+ has it), and readers copy a slot and keep the copy only if its stamp did not change
+ meanwhile. Individuals are stored as their raw genome words (see Individual.h).
+
+*/
+
+static const uint32_t SEGMENT_MAGIC = 0x4d415853;
+static const uint32_t SEGMENT_VERSION = 2;
+
+// The header and slots are aligned to cache lines, so writers of neighbouring slots
+// don't contend, and the genome of a slot starts SLOT_HEADER_SIZE bytes into it
+static const size_t LINE = 64;
+static const size_t HEADER_SIZE = 64;
+static const size_t SLOT_HEADER_SIZE = 24;
+
+// Up to MAX_LEASES processes may be attached at once. A lease is renewed every
+// LEASE_RENEWAL milliseconds, and lapses if not renewed for LEASE_EXPIRY milliseconds
+static const int MAX_LEASES = 64;
+static const int64_t LEASE_RENEWAL = 1000;
+static const int64_t LEASE_EXPIRY = 5000;
+
+struct SharedMigration::Header {
+    std::atomic<uint32_t> ready;
+    uint32_t version;
+    uint64_t fingerprint;
+    uint32_t numWords;
+    uint32_t numSlots;
+    std::atomic<int32_t> stop;
+    std::atomic<uint64_t> tickets;
+};
+
+// An attached process's claim on the segment: its sender id (0 for a free lease) and
+// when it last renewed the claim, in milliseconds since the epoch. The wall clock is
+// used because, unlike the monotonic clock, it is the same in every container
+struct SharedMigration::Lease {
+    std::atomic<uint64_t> owner;
+    std::atomic<int64_t> renewed;
+};
+
+// The genome words follow each slot
+struct SharedMigration::Slot {
+    // 0 while the slot is empty, odd while it is being written
+    std::atomic<uint64_t> stamp;
+    std::atomic<double> fitness;
+    uint64_t sender;
+};
+
+/*
+ Returns the current time in milliseconds since the epoch
+*/
+static int64_t wallClock()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/*
+ Returns a random nonzero id for an attachment, from /dev/urandom if it can be read, and
+ otherwise mixed from the time and process id
+*/
+static uint64_t randomSender()
+{
+    uint64_t id = 0;
+    int fd = open("/dev/urandom", O_RDONLY);
+    if (fd >= 0) {
+        if (read(fd, &id, sizeof(id)) != sizeof(id))
+            id = 0;
+        close(fd);
+    }
+    if (id == 0) {
+        id = static_cast<uint64_t>(std::chrono::high_resolution_clock::now().time_since_epoch().count())
+             ^ (static_cast<uint64_t>(getpid()) << 32);
+        id = (id ^ (id >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        id = (id ^ (id >> 27)) * 0x94D049BB133111EBULL;
+        id ^= id >> 31;
+    }
+    return id ? id : 1;
+}
+
+/*
+ Returns a hash identifying a problem, so processes working on different problems (or
+ differently preprocessed ones) never share a segment
+*/
+static uint64_t problemFingerprint(const CNF& problem)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    hash = (hash ^ static_cast<uint64_t>(problem.getNumVars())) * 1099511628211ULL;
+    hash = (hash ^ static_cast<uint64_t>(problem.getNumClauses())) * 1099511628211ULL;
+    for (size_t i = 0; i < problem.getNumLiterals(); i++)
+        hash = (hash ^ problem.getLiterals()[i]) * 1099511628211ULL;
+    for (int i = 0; i <= problem.getNumClauses(); i++)
+        hash = (hash ^ problem.getOffsets()[i]) * 1099511628211ULL;
+    return hash;
+}
+
+/*
+ Returns the genome words stored after a slot
+*/
+static uint64_t* slotGenome(const void* slot)
+{
+    return reinterpret_cast<uint64_t*>(const_cast<char*>(static_cast<const char*>(slot)) + SLOT_HEADER_SIZE);
+}
+
+/*
+ Creates the shared segment, or attaches to it if another process already has
+ Parameters:
+        name_: Name of the segment, shared by every cooperating process
+        problem: The problem being solved, which must be the same in every process
+        prototype: An individual of the problem, giving the size of the genomes stored
+        interval_: How often (in generations or iterations) to exchange individuals
+        numMigrants_: How many individuals to exchange each time
+*/
+SharedMigration::SharedMigration(const std::string& name_, const CNF& problem, const Individual& prototype,
+                                 int interval_, int numMigrants_)
+    : name(name_[0] == '/' ? name_ : "/" + name_), interval(std::max(1, interval_)),
+      numMigrants(std::max(0, numMigrants_)), numWords(prototype.genomeWords()),
+      numSlots(std::max(64, 4 * numMigrants)), sender(randomSender()), detaching(false), leaseLost(false)
+{
+    static_assert(sizeof(Header) <= HEADER_SIZE, "header must fit its cache line");
+    static_assert(sizeof(Slot) <= SLOT_HEADER_SIZE, "slot header must fit before the genome");
+    
+    slotSize = (SLOT_HEADER_SIZE + numWords * sizeof(uint64_t) + LINE - 1) / LINE * LINE;
+    segmentSize = HEADER_SIZE + MAX_LEASES * sizeof(Lease) + (numSlots + 1) * slotSize;
+    uint64_t fingerprint = problemFingerprint(problem);
+
+    // A mismatched segment that no live process holds is removed and made anew
+    std::string mismatch;
+    if (!mapSegment(fingerprint, mismatch) && !mapSegment(fingerprint, mismatch)) {
+        std::cout << "Shared memory segment " << name << " " << mismatch << std::endl;
+        exit(1);
+    }
+
+    // Finding no other live process means the segment is new or was left behind by
+    // runs that crashed, whose stop flag, best individual and migrants don't apply any
+    // more. Two processes attaching at once may both reset it, which is harmless since
+    // neither has published anything yet
+    if (!othersAttached()) {
+        header->stop.store(0);
+        header->tickets.store(0);
+        for (int i = 0; i <= numSlots; i++)
+            slotAt(i)->stamp.store(0);
+    }
+    if (!attach()) {
+        std::cout << "Shared memory segment " << name << " already has " << MAX_LEASES << " processes attached" << std::endl;
+        exit(1);
+    }
+    renewer = std::thread(&SharedMigration::heartbeat, this);
+}
+
+/*
+ Creates and maps the shared segment, or maps it if another process already has
+ created it, waiting for its creator to finish setting it up
+ Parameters:
+        fingerprint: Hash identifying the problem being solved
+        mismatch: Output, why the segment could not be used if it could not
+ Returns whether the segment was mapped. If it was set up for another problem, another
+ number of migrants or another version of ga it is not, and it is removed if no live
+ process is attached to it, so that a retry creates it anew
+*/
+bool SharedMigration::mapSegment(uint64_t fingerprint, std::string& mismatch)
+{
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    bool created = (fd >= 0);
+    if (created) {
+        if (ftruncate(fd, segmentSize) != 0) {
+            std::cout << "Shared memory segment " << name << " could not be created" << std::endl;
+            exit(1);
+        }
+    } else if (errno == EEXIST) {
+        fd = shm_open(name.c_str(), O_RDWR, 0600);
+    }
+    struct stat info;
+    for (int wait = 0; fd >= 0 && fstat(fd, &info) == 0 && info.st_size == 0 && wait < 5000; wait++)
+        usleep(1000);
+    if (fd < 0 || fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < HEADER_SIZE + MAX_LEASES * sizeof(Lease)) {
+        std::cout << "Shared memory segment " << name << " could not be opened" << std::endl;
+        exit(1);
+    }
+
+    size_t mappedSize = info.st_size;
+    segment = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED) {
+        std::cout << "Shared memory segment " << name << " could not be mapped" << std::endl;
+        exit(1);
+    }
+    header = static_cast<Header*>(segment);
+
+    // The new segment is zero filled, which is a valid empty state for every atomic
+    if (created) {
+        header->version = SEGMENT_VERSION;
+        header->fingerprint = fingerprint;
+        header->numWords = numWords;
+        header->numSlots = numSlots;
+        header->ready.store(SEGMENT_MAGIC, std::memory_order_release);
+    }
+    for (int wait = 0; header->ready.load(std::memory_order_acquire) != SEGMENT_MAGIC && wait < 5000; wait++)
+        usleep(1000);
+    if (header->ready.load(std::memory_order_acquire) != SEGMENT_MAGIC || header->version != SEGMENT_VERSION)
+        mismatch = "was made by a different version of ga";
+    else if (header->fingerprint != fingerprint || header->numWords != static_cast<uint32_t>(numWords))
+        mismatch = "belongs to a different problem";
+    else if (header->numSlots != static_cast<uint32_t>(numSlots))
+        mismatch = "holds " + std::to_string(header->numSlots) + " migrant slots, but --shared-migrants "
+                   + std::to_string(numMigrants) + " needs " + std::to_string(numSlots);
+    else if (mappedSize != segmentSize)
+        mismatch = "has the wrong size";
+    else
+        return true;
+    
+    // Only the leases of a segment of this version can be trusted
+    bool abandoned = header->version == SEGMENT_VERSION && !othersAttached();
+    munmap(segment, mappedSize);
+    if (abandoned)
+        shm_unlink(name.c_str());
+    return false;
+}
+
+/*
+ Detaches from the segment, removing it if no other live process is attached
+*/
+SharedMigration::~SharedMigration()
+{
+    {
+        std::lock_guard<std::mutex> lock(renewMutex);
+        detaching = true;
+    }
+    renewSignal.notify_all();
+    renewer.join();
+    
+    for (int i = 0; i < MAX_LEASES; i++) {
+        uint64_t owner = sender;
+        leaseAt(i)->owner.compare_exchange_strong(owner, 0);
+    }
+    if (!othersAttached())
+        shm_unlink(name.c_str());
+    munmap(segment, segmentSize);
+}
+
+/*
+ Returns a lease of the segment
+*/
+SharedMigration::Lease* SharedMigration::leaseAt(int index) const
+{
+    return reinterpret_cast<Lease*>(static_cast<char*>(segment) + HEADER_SIZE) + index;
+}
+
+/*
+ Returns whether any process other than this one holds a lease that has not lapsed
+*/
+bool SharedMigration::othersAttached() const
+{
+    int64_t now = wallClock();
+    for (int i = 0; i < MAX_LEASES; i++) {
+        const Lease* lease = leaseAt(i);
+        uint64_t owner = lease->owner.load();
+        if (owner != 0 && owner != sender && now - lease->renewed.load() < LEASE_EXPIRY)
+            return true;
+    }
+    return false;
+}
+
+/*
+ Claims a free or lapsed lease for this process
+ Returns whether there was one to claim
+*/
+bool SharedMigration::attach()
+{
+    for (int i = 0; i < MAX_LEASES; i++) {
+        Lease* lease = leaseAt(i);
+        uint64_t owner = lease->owner.load();
+        if (owner != 0 && wallClock() - lease->renewed.load() < LEASE_EXPIRY)
+            continue;
+        // Renew before claiming, so that the claim is never seen as lapsed
+        lease->renewed.store(wallClock());
+        if (lease->owner.compare_exchange_strong(owner, sender))
+            return true;
+    }
+    return false;
+}
+
+/*
+ Renews this process's lease every LEASE_RENEWAL milliseconds until it detaches,
+ claiming a new one if the lease was taken over after lapsing (e.g. while the
+ process was stopped). If every lease is taken by then, the process is no longer
+ counted as attached, so it gives up renewing and has stopRequested tell the engine
+ running on it to stop, rather than exiting from this thread
+*/
+void SharedMigration::heartbeat()
+{
+    std::unique_lock<std::mutex> lock(renewMutex);
+    while (!renewSignal.wait_for(lock, std::chrono::milliseconds(LEASE_RENEWAL), [this] { return detaching; })) {
+        bool held = false;
+        for (int i = 0; i < MAX_LEASES && !held; i++) {
+            Lease* lease = leaseAt(i);
+            if (lease->owner.load() == sender) {
+                lease->renewed.store(wallClock());
+                held = true;
+            }
+        }
+        if (!held && !attach()) {
+            leaseLost.store(true, std::memory_order_release);
+            return;
+        }
+    }
+}
+
+/*
+ Returns a slot of the segment: 0 is the best individual, and the migrants follow
+*/
+SharedMigration::Slot* SharedMigration::slotAt(int index) const
+{
+    return reinterpret_cast<Slot*>(static_cast<char*>(segment) + HEADER_SIZE + MAX_LEASES * sizeof(Lease)
+                                   + index * slotSize);
+}
+
+/*
+ Copies an individual into the next migrant slot. If another writer still holds that
+ slot, the individual is dropped rather than waiting
+ Parameters:
+        individual: The individual to publish
+        fitness: Its fitness
+*/
+void SharedMigration::publish(const Individual& individual, double fitness)
+{
+    uint64_t ticket = header->tickets.fetch_add(1, std::memory_order_relaxed);
+    Slot* slot = slotAt(1 + ticket % numSlots);
+    uint64_t stamp = slot->stamp.load(std::memory_order_relaxed);
+    if ((stamp & 1) || !slot->stamp.compare_exchange_strong(stamp, stamp | 1, std::memory_order_acquire))
+        return;
+
+    slot->sender = sender;
+    slot->fitness.store(fitness, std::memory_order_relaxed);
+    individual.writeGenome(slotGenome(slot));
+    slot->stamp.store(2 * ticket + 2, std::memory_order_release);
+}
+
+/*
+ Copies a slot's individual out, if the slot still holds what it held at the given stamp
+ and was published by another process
+ Parameters:
+        slot: The slot to read
+        stamp: The (even) stamp read from the slot before
+        into: Individual to copy the genome into
+ Returns whether the individual was read
+*/
+bool SharedMigration::readSlot(const Slot* slot, uint64_t stamp, Individual& into) const
+{
+    static thread_local std::vector<uint64_t> scratch;
+    scratch.resize(numWords);
+    uint64_t from = slot->sender;
+    memcpy(scratch.data(), slotGenome(slot), numWords * sizeof(uint64_t));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot->stamp.load(std::memory_order_relaxed) != stamp || from == sender)
+        return false;
+
+    into.readGenome(scratch.data());
+    return true;
+}
+
+/*
+ Reads migrants published by other processes since the last call with the same cursor,
+ oldest first. When more are waiting than can be read, the cursor only moves past
+ those read, so the rest are read next time (unless they were overwritten meanwhile)
+ Parameters:
+        into: Individuals to overwrite with the migrants
+        max: Largest number of migrants to read (at most into.size())
+        cursor: Stamp of the newest migrant consumed so far, updated
+ Returns the number of migrants read into the start of into
+*/
+int SharedMigration::collect(std::vector<std::shared_ptr<Individual>>& into, int max, uint64_t& cursor) const
+{
+    static thread_local std::vector<std::pair<uint64_t, int>> waiting;
+    waiting.clear();
+    for (int i = 1; i <= numSlots; i++) {
+        uint64_t stamp = slotAt(i)->stamp.load(std::memory_order_acquire);
+        if (stamp != 0 && !(stamp & 1) && stamp > cursor)
+            waiting.push_back(std::make_pair(stamp, i));
+    }
+    std::sort(waiting.begin(), waiting.end());
+    
+    // A slot that fails to read was published by this process, or is being
+    // overwritten by a newer migrant that a later call will see; either way it is
+    // consumed
+    int count = 0;
+    for (unsigned int i = 0; i < waiting.size() && count < max; i++) {
+        if (readSlot(slotAt(waiting[i].second), waiting[i].first, *into[count]))
+            count++;
+        cursor = waiting[i].first;
+    }
+    return count;
+}
+
+/*
+ Records an individual as the best found by any process, if it beats the current record.
+ If another process is writing the record at the same moment, the offer is dropped
+ Parameters:
+        individual: The individual to offer
+        fitness: Its fitness
+*/
+void SharedMigration::offerBest(const Individual& individual, double fitness)
+{
+    Slot* best = slotAt(0);
+    uint64_t stamp = best->stamp.load(std::memory_order_acquire);
+    if ((stamp & 1) || (stamp != 0 && best->fitness.load(std::memory_order_relaxed) >= fitness))
+        return;
+    if (!best->stamp.compare_exchange_strong(stamp, stamp + 1, std::memory_order_acquire))
+        return;
+
+    if (stamp == 0 || best->fitness.load(std::memory_order_relaxed) < fitness) {
+        best->sender = sender;
+        best->fitness.store(fitness, std::memory_order_relaxed);
+        individual.writeGenome(slotGenome(best));
+    }
+    best->stamp.store(stamp + 2, std::memory_order_release);
+}
+
+/*
+ Reads the best individual found by any process (including this one)
+ Parameters:
+        into: Individual to copy the best genome into
+ Returns whether there was a best individual to read
+*/
+bool SharedMigration::readBest(Individual& into) const
+{
+    std::vector<uint64_t> words(numWords);
+    const Slot* best = slotAt(0);
+    for (int attempt = 0; attempt < 1000; attempt++) {
+        uint64_t stamp = best->stamp.load(std::memory_order_acquire);
+        if (stamp == 0)
+            return false;
+        if (stamp & 1)
+            continue;
+        memcpy(words.data(), slotGenome(best), numWords * sizeof(uint64_t));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (best->stamp.load(std::memory_order_relaxed) == stamp) {
+            into.readGenome(words.data());
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ Tells every process to stop, because a complete solution was found
+*/
+void SharedMigration::requestStop()
+{
+    header->stop.store(1, std::memory_order_release);
+}
+
+/*
+ Returns whether any process has found a complete solution, or this process has lost
+ its lease (see heartbeat)
+*/
+bool SharedMigration::stopRequested() const
+{
+    return header->stop.load(std::memory_order_acquire) != 0 || leaseLost.load(std::memory_order_acquire);
+}
+
+/*
+ Returns why stopRequested told the process to stop, to report at the end of its run
+*/
+const char* SharedMigration::stopReason() const
+{
+    if (leaseLost.load(std::memory_order_acquire))
+        return "Stopped: this process lost its place in the shared segment.";
+    return "Stopped: another process found a complete solution.";
+}
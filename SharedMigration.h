@@ -0,0 +1,101 @@
+#pragma once
+
+#include "Individual.h"
+#include "readCNF.h"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*
+
+ ****************************
+ *     SharedMigration      *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+
+ See SharedMigration.cpp for more documentation.
+
+*/
+
+// A POSIX shared memory segment through which several ga processes on one machine
+// work on the same problem together. It holds a ring of migrant slots, the best
+// individual found by any process, and a flag telling every process to stop. Every
+// slot is guarded by its own sequence stamp, so processes never lock or wait for
+// each other, and one crashing never blocks the rest. Each attached process holds a
+// lease that a background thread renews, so processes killed without detaching are
+// noticed, and a segment nobody holds a live lease on is reset before it is reused.
+// Class and method documentation can be found in SharedMigration.cpp
+class SharedMigration {
+public:
+    SharedMigration(const std::string& name_, const CNF& problem, const Individual& prototype,
+                    int interval_, int numMigrants_);
+    ~SharedMigration();
+
+    // How often (in generations or iterations) and how many individuals to exchange
+    int getInterval() const { return interval; }
+    int getNumMigrants() const { return numMigrants; }
+
+    // Copies an individual into the next migrant slot
+    void publish(const Individual& individual, double fitness);
+
+    // Reads up to max migrants published by other processes since the last collect
+    // with the same cursor (which starts at 0) into the given individuals
+    int collect(std::vector<std::shared_ptr<Individual>>& into, int max, uint64_t& cursor) const;
+
+    // Records an individual as the best of all processes, if it is
+    void offerBest(const Individual& individual, double fitness);
+
+    // Reads the best individual of all processes, returning false if there is none yet
+    bool readBest(Individual& into) const;
+
+    // Tells every process to stop, because a complete solution was found. A process
+    // is also told to stop if it loses its place in the segment
+    void requestStop();
+    bool stopRequested() const;
+    const char* stopReason() const;
+
+private:
+    struct Header;
+    struct Lease;
+    struct Slot;
+
+    bool mapSegment(uint64_t fingerprint, std::string& mismatch);
+    Lease* leaseAt(int index) const;
+    bool othersAttached() const;
+    bool attach();
+    void heartbeat();
+    Slot* slotAt(int index) const;
+    bool readSlot(const Slot* slot, uint64_t stamp, Individual& into) const;
+
+    std::string name;
+    int interval;
+    int numMigrants;
+
+    // The mapped segment and its layout
+    void* segment;
+    size_t segmentSize;
+    Header* header;
+    int numWords;
+    int numSlots;
+    size_t slotSize;
+
+    // Identifies this attachment's lease and migrants, so its migrants are not
+    // collected back. Drawn at random, since processes in different containers can
+    // share a process id
+    uint64_t sender;
+    
+    // The thread renewing the lease, and what it waits on between renewals
+    std::thread renewer;
+    std::mutex renewMutex;
+    std::condition_variable renewSignal;
+    bool detaching;
+    
+    // Set by the renewing thread if the lease lapsed and no other was free
+    std::atomic<bool> leaseLost;
+};
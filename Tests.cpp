@@ -0,0 +1,331 @@
+#include "Individual.h"
+#include "readCNF.h"
+#include "Random.h"
+#include "BitSlice.h"
+#include "Preprocessor.h"
+#include "LocalSearch.h"
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdio>
+#include <cstdint>
+#include <unistd.h>
+
+/*
+
+ ****************************
+ *          Tests           *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+
+ Checks of the parts of the program whose results must agree with a slower reference:
+ the bit-sliced kernels against each other and a plain clause scan, incremental fitness
+ against rescoring from scratch, the Preprocessor's mapping of solutions back to the
+ original problem, and the binary cache against the parser. Run with "make test";
+ the program prints each failed check and exits with 1 if there were any.
+
+*/
+
+static int failures = 0;
+
+/*
+ Records the outcome of a check, printing it if it failed
+ Parameters:
+        ok: Whether the check passed
+        what: Description of the check
+*/
+static void check(bool ok, const std::string& what)
+{
+    if (!ok) {
+        std::cout << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+/*
+ Fills a CNF with random clauses of minLength to four literals. With a planted assignment
+ every clause is made to contain a literal it satisfies, so the problem is satisfiable
+ Parameters:
+        cnf: The empty CNF to fill
+        numVars: Number of variables to draw from
+        numClauses: Number of clauses
+        minLength: Fewest literals in a clause
+        rng: Random stream to draw the clauses from
+        planted: An assignment (a 0 or 1 per variable) to satisfy, or NULL
+*/
+static void randomClauses(CNF& cnf, int numVars, int numClauses, int minLength, Random& rng,
+                          const std::vector<char>* planted = NULL)
+{
+    for (int i = 0; i < numClauses; i++) {
+        int length = minLength + rng.nextInt(5 - minLength);
+        for (int j = 0; j < length; j++) {
+            int var = 1 + rng.nextInt(numVars);
+            bool negated = rng.nextInt(2);
+            if (planted && j == 0)
+                negated = !(*planted)[var - 1];
+            cnf.addLiteral(negated ? -var : var);
+        }
+        cnf.endClause();
+    }
+}
+
+/*
+ Counts the clauses an assignment satisfies by scanning every literal
+ Parameters:
+        cnf: The problem
+        words: The assignment, packed as in MAXSATIndividual
+ Returns the number of satisfied clauses
+*/
+static int countSatisfied(const CNF& cnf, const uint64_t* words)
+{
+    int satisfied = 0;
+    for (int c = 0; c < cnf.getNumClauses(); c++) {
+        for (const unsigned int* lit = cnf.clauseBegin(c); lit != cnf.clauseEnd(c); lit++) {
+            int value = (words[CNF::literalVar(*lit) >> 6] >> (CNF::literalVar(*lit) & 63)) & 1;
+            if (value != static_cast<int>(CNF::literalNegated(*lit))) {
+                satisfied++;
+                break;
+            }
+        }
+    }
+    return satisfied;
+}
+
+/*
+ Checks that every bit-sliced kernel the CPU supports scores full and partial batches
+ the same as a plain clause scan
+*/
+static void testBitSlice()
+{
+    Random rng(1);
+    CNF cnf;
+    randomClauses(cnf, 150, 700, 1, rng);
+    int numWords = MAXSATIndividual::numWords(cnf.getNumVars());
+    BitSliceProblem problem = { cnf.getLiterals(), cnf.getOffsets(), cnf.getNumClauses(), cnf.getNumVars() };
+
+    const int count = 600;
+    std::vector<uint64_t> data(static_cast<size_t>(count) * numWords);
+    rng.fillWords(data.data(), data.size());
+    std::vector<const uint64_t*> genomes(count);
+    std::vector<int> expected(count);
+    for (int i = 0; i < count; i++) {
+        genomes[i] = data.data() + static_cast<size_t>(i) * numWords;
+        expected[i] = countSatisfied(cnf, genomes[i]);
+    }
+
+    struct { BitSliceKernel kernel; int batchSize; const char* name; bool supported; } kernels[] = {
+        { &bitSliceScalar, 64, "scalar", true },
+        { &bitSliceSSE2, 128, "SSE2", bitSliceHasSSE2() },
+        { &bitSliceAVX2, 256, "AVX2", bitSliceHasAVX2() }
+    };
+    for (unsigned int k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        if (!kernels[k].supported) {
+            std::cout << "Skipping the " << kernels[k].name << " kernel, which this CPU does not support" << std::endl;
+            continue;
+        }
+        int batchSize = kernels[k].batchSize;
+        std::vector<uint64_t> rows(bitSliceRowWords(cnf.getNumVars(), batchSize));
+        std::vector<int> fitness(count);
+        for (int first = 0; first < count; first += batchSize) {
+            int n = std::min(batchSize, count - first);
+            kernels[k].kernel(problem, genomes.data() + first, n, rows.data(), fitness.data() + first);
+        }
+        check(fitness == expected, std::string("the ") + kernels[k].name + " kernel matches a clause scan");
+
+        // A batch of a single genome leaves most lanes of the kernel empty
+        int one = -1;
+        kernels[k].kernel(problem, genomes.data() + 7, 1, rows.data(), &one);
+        check(one == expected[7], std::string("the ") + kernels[k].name + " kernel scores a batch of one");
+    }
+
+    std::vector<int> fitness(count);
+    evaluateBitSliced(cnf, genomes.data(), count, fitness.data());
+    check(fitness == expected, std::string("evaluateBitSliced (") + bitSliceKernelName() + ") matches a clause scan");
+}
+
+/*
+ Checks that individuals tracking their fitness incrementally through mutation, local
+ search, crossover and copying always agree with rescoring their assignment from
+ scratch, and that batch evaluation agrees with scoring one at a time
+*/
+static void testIncrementalFitness()
+{
+    Random rng(2);
+    CNF cnf;
+    randomClauses(cnf, 200, 850, 1, rng);
+    cnf.buildOccurrences();
+
+    MAXSATIndividual parent1(cnf, rng), parent2(cnf, rng), child1(cnf, rng), child2(cnf, rng);
+    LocalSearchSettings walk;
+    walk.method = LocalSearchMethod::walkSAT;
+    walk.maxFlips = 20;
+
+    int mismatches = 0;
+    for (int step = 0; step < 400; step++) {
+        switch (step % 5) {
+            case 0: parent1.mutate(MutationMethod::uniform, 0.02, rng); break;
+            case 1: parent1.mutate(MutationMethod::focused, 0.05, rng); break;
+            case 2: parent1.localSearch(walk, rng); break;
+            case 3: parent1.breedInto<CrossoverMethod::onePoint>(parent2, rng, child1, child2); break;
+            case 4: parent1.breedInto<CrossoverMethod::uniform>(parent2, rng, child1, child2); break;
+        }
+        MAXSATIndividual* checked[] = { &parent1, &child1, &child2 };
+        for (int i = 0; i < 3; i++) {
+            MAXSATIndividual rescored(cnf, checked[i]->getWords());
+            if (checked[i]->evaluateFitness() != rescored.evaluateFitness() ||
+                rescored.evaluateFitness() != countSatisfied(cnf, checked[i]->getWords().data()))
+                mismatches++;
+        }
+
+        // Keep the population moving: the children become the next parents
+        if (step % 5 == 4) {
+            parent2.copyFrom(child1);
+            child2.mutate(MutationMethod::focused, 0.05, rng);
+            parent1.copyFrom(child2);
+        }
+    }
+    check(mismatches == 0, "incremental fitness matches rescoring (" + std::to_string(mismatches) + " mismatches)");
+
+    // Batches too small for the bit-sliced kernel are scored one at a time, so try both
+    const int sizes[] = { 5, 300 };
+    for (int s = 0; s < 2; s++) {
+        std::vector<std::shared_ptr<Individual>> population;
+        for (int i = 0; i < sizes[s]; i++)
+            population.push_back(std::shared_ptr<Individual>(new MAXSATIndividual(cnf, rng)));
+        std::vector<MAXSATIndividual*> typed = typedIndividuals<MAXSATIndividual>(population);
+        std::vector<double> evaluations(sizes[s]);
+        MAXSATIndividual::evaluateBatch(typed.data(), sizes[s], evaluations.data());
+        bool same = true;
+        for (int i = 0; i < sizes[s]; i++)
+            same = same && evaluations[i] == countSatisfied(cnf, typed[i]->getWords().data());
+        check(same, "batch evaluation of " + std::to_string(sizes[s]) + " individuals matches a clause scan");
+    }
+}
+
+/*
+ Checks the Preprocessor on small random problems by trying every assignment of the
+ simplified problem: each must map back to an assignment of the original that keeps its
+ free variables and is scored the same by originalFitness as by the original clauses.
+ With maxsat the best mapped assignment must be as good as the best of the original,
+ and with sat a satisfiable problem must still have a complete solution
+*/
+static void testPreprocessor()
+{
+    Random rng(3);
+    for (int round = 0; round < 6; round++) {
+        bool sat = (round % 2 == 1);
+        int numVars = 12;
+        std::vector<char> planted(numVars);
+        for (int v = 0; v < numVars; v++)
+            planted[v] = rng.nextInt(2);
+        CNF original;
+        randomClauses(original, numVars, 30, round < 4 ? 2 : 1, rng, sat ? &planted : NULL);
+        original.buildOccurrences();
+        numVars = original.getNumVars();
+
+        // The best number of original clauses any assignment satisfies
+        int bestOriginal = 0;
+        for (uint64_t word = 0; word < (1ULL << numVars); word++)
+            bestOriginal = std::max(bestOriginal, countSatisfied(original, &word));
+
+        CNF simplified;
+        Preprocessor preprocessor(original, simplified, sat ? PreprocessLevel::sat : PreprocessLevel::maxsat);
+        int freeVars = simplified.getNumVars();
+        std::string problem = std::string(sat ? "sat" : "maxsat") + " problem " + std::to_string(round);
+        check(freeVars <= numVars, "the " + problem + " has no more variables once simplified");
+
+        bool mapped = true;
+        int bestMapped = 0;
+        std::vector<char> assignment;
+        for (uint64_t word = 0; word < (1ULL << freeVars); word++) {
+            MAXSATIndividual individual(simplified, std::vector<uint64_t>(MAXSATIndividual::numWords(freeVars), word));
+            preprocessor.restore(individual, assignment);
+            uint64_t restored = 0;
+            for (int v = 0; v < numVars; v++)
+                restored |= static_cast<uint64_t>(assignment[v] & 1) << v;
+            int fitness = preprocessor.originalFitness(individual);
+            mapped = mapped && static_cast<int>(assignment.size()) == numVars &&
+                     fitness == countSatisfied(original, &restored) &&
+                     fitness == preprocessor.countSatisfied(assignment);
+            bestMapped = std::max(bestMapped, fitness);
+        }
+        check(mapped, "solutions of the " + problem + " map back to the original");
+        if (sat)
+            check(bestMapped == original.getNumClauses(), "the " + problem + " keeps a complete solution");
+        else
+            check(bestMapped == bestOriginal, "the " + problem + " keeps its best solution (" +
+                  std::to_string(bestMapped) + " of " + std::to_string(bestOriginal) + ")");
+    }
+}
+
+/*
+ Checks that a problem mapped from the binary cache is the same as the one parsed from
+ the text, and that a damaged cache is parsed around rather than trusted
+*/
+static void testCache()
+{
+    char path[] = "/tmp/gatestXXXXXX";
+    int fd = mkstemp(path);
+    check(fd >= 0, "a temporary problem file can be made");
+    if (fd < 0)
+        return;
+
+    Random rng(4);
+    CNF generated;
+    randomClauses(generated, 300, 1200, 1, rng);
+    std::string text = "c random problem\np cnf 300 " + std::to_string(generated.getNumClauses()) + "\n";
+    for (int c = 0; c < generated.getNumClauses(); c++) {
+        for (const unsigned int* lit = generated.clauseBegin(c); lit != generated.clauseEnd(c); lit++)
+            text += std::to_string(CNF::decodeLiteral(*lit)) + " ";
+        text += "0\n";
+    }
+    check(write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size()), "the problem file is written");
+    close(fd);
+    std::string cachePath = std::string(path) + ".bin";
+
+    CNF parsed;
+    readClauses(path, parsed);
+    check(!parsed.isMapped(), "a problem without a cache is parsed");
+
+    for (int pass = 0; pass < 2; pass++) {
+        bool damaged = (pass == 1);
+        if (damaged)
+            check(truncate(cachePath.c_str(), 4096) == 0, "the cache can be damaged");
+
+        CNF cached;
+        readClauses(path, cached);
+        std::string which = damaged ? "after a damaged cache" : "from the cache";
+        check(cached.isMapped() == !damaged, damaged ? "a damaged cache is not mapped" : "an up to date cache is mapped");
+        bool same = cached.getNumVars() == parsed.getNumVars() && cached.getNumClauses() == parsed.getNumClauses() &&
+                    cached.getNumLiterals() == parsed.getNumLiterals() &&
+                    std::equal(parsed.getLiterals(), parsed.getLiterals() + parsed.getNumLiterals(), cached.getLiterals()) &&
+                    std::equal(parsed.getOffsets(), parsed.getOffsets() + parsed.getNumClauses() + 1, cached.getOffsets());
+        for (int v = 0; same && v < parsed.getNumVars(); v++)
+            same = std::equal(parsed.occurrenceBegin(v), parsed.occurrenceEnd(v), cached.occurrenceBegin(v)) &&
+                   cached.occurrenceEnd(v) - cached.occurrenceBegin(v) == parsed.occurrenceEnd(v) - parsed.occurrenceBegin(v);
+        check(same, "the problem read " + which + " matches the parsed one");
+        check(same && parsed.getNumClauses() == generated.getNumClauses() &&
+              std::equal(parsed.getLiterals(), parsed.getLiterals() + parsed.getNumLiterals(), generated.getLiterals()),
+              "the parsed problem matches the one written");
+    }
+
+    unlink(path);
+    unlink(cachePath.c_str());
+}
+
+int main()
+{
+    testBitSlice();
+    testIncrementalFitness();
+    testPreprocessor();
+    testCache();
+
+    if (failures) {
+        std::cout << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All checks passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "ThreadPool.h"
+
+/*
+ 
+ ****************************
+ *        ThreadPool        *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+ 
+ The ThreadPool class contains code for running batches of independent tasks over a
+ fixed set of threads. The algorithms split their populations into one chunk of work
+ per thread and hand those chunks to the pool each generation, so threads are
+ created once per run rather than once per generation.
+ 
+*/
+
+/*
+ Constructor for the pool, which starts the worker threads
+ Parameters:
+        numThreads: Total number of threads to run tasks on, including the calling thread
+*/
+ThreadPool::ThreadPool(int numThreads)
+    : currentInvoker(NULL), currentTask(NULL), numTasks(0), nextTask(0), unfinished(0), batch(0), stopping(false)
+{
+    for (int i = 1; i < numThreads; i++)
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+/*
+ Destructor for the pool, which stops and joins the worker threads
+*/
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (unsigned int i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+/*
+ Runs task(i) for every i in [0, numTasks) across the threads of the pool, returning
+ once all of them have finished
+ Parameters:
+        numTasks_: Number of tasks to run
+        invoker: Calls the task for a task index
+        task: The work to do for each task index, passed to invoker
+*/
+void ThreadPool::runErased(int numTasks_, void (*invoker)(const void*, int), const void* task)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    currentInvoker = invoker;
+    currentTask = task;
+    numTasks = numTasks_;
+    nextTask = 0;
+    unfinished = numTasks_;
+    batch++;
+    wake.notify_all();
+    
+    // Work alongside the pool, then wait for any tasks still running elsewhere
+    runTasks(lock);
+    while (unfinished > 0)
+        finished.wait(lock);
+    currentInvoker = NULL;
+    currentTask = NULL;
+}
+
+/*
+ Claims and runs tasks from the current batch until none are left. The lock is
+ released while a task runs.
+ Parameters:
+        lock: The held lock on the pool's mutex
+*/
+void ThreadPool::runTasks(std::unique_lock<std::mutex>& lock)
+{
+    while (nextTask < numTasks) {
+        int index = nextTask++;
+        void (*invoker)(const void*, int) = currentInvoker;
+        const void* task = currentTask;
+        
+        lock.unlock();
+        invoker(task, index);
+        lock.lock();
+        
+        if (--unfinished == 0)
+            finished.notify_all();
+    }
+}
+
+/*
+ The loop run by each worker thread: sleep until a new batch is posted, help run it,
+ and repeat until the pool is destroyed
+*/
+void ThreadPool::workerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    unsigned long seenBatch = batch;
+    while (true) {
+        while (!stopping && batch == seenBatch)
+            wake.wait(lock);
+        if (stopping)
+            return;
+        
+        seenBatch = batch;
+        runTasks(lock);
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*
+ 
+ ****************************
+ *        ThreadPool        *
+ ****************************
+ This program attempts to fulfill Project 1 for CS3445 at Bowdoin College.
+ Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
+ 
+ See ThreadPool.cpp for more documentation.
+ 
+*/
+
+// A fixed set of threads that run numbered tasks in parallel. The thread calling
+// run() works on tasks too, so a pool of size 1 starts no extra threads and runs
+// everything serially.
+class ThreadPool {
+public:
+    explicit ThreadPool(int numThreads);
+    ~ThreadPool();
+    
+    int size() const { return static_cast<int>(workers.size()) + 1; }
+    
+    // Runs task(i) for every i in [0, numTasks) and waits for all of them. The task is
+    // passed by reference rather than wrapped in a std::function, so running a batch
+    // never allocates
+    template <class Task>
+    void run(int numTasks, const Task& task) { runErased(numTasks, &invoke<Task>, &task); }
+
+private:
+    template <class Task>
+    static void invoke(const void* task, int index) { (*static_cast<const Task*>(task))(index); }
+    
+    void runErased(int numTasks, void (*invoker)(const void*, int), const void* task);
+    void workerLoop();
+    void runTasks(std::unique_lock<std::mutex>& lock);
+    
+    std::vector<std::thread> workers;
+    
+    // State of the current batch of tasks, guarded by mutex
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    void (*currentInvoker)(const void*, int);
+    const void* currentTask;
+    int numTasks;
+    int nextTask;
+    int unfinished;
+    unsigned long batch;
+    bool stopping;
+};
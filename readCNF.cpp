@@ -1,4 +1,15 @@
 #include "readCNF.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 /*
  
@@ -9,77 +20,574 @@
  Daniel Cohen, Josh Imhoff, and Liam Taylor. 2015.
  
  This file contains code for reading in Conjunctive Normal Form (.cnf) files
- and storing their logical information. The format of the .cnf files is specific.
+ and storing their logical information. The files are expected in the DIMACS
+ format: "c" comment lines, a "p cnf <variables> <clauses>" header, and clauses
+ as whitespace separated literals each ended by a 0. Parsed files are cached
+ in a binary form next to them, which later runs memory map directly.
  
 */
 
-// Global variables (see readCNF.h)
-std::vector<std::vector<int>> clauses;
-std::string filepath;
+/*
+ Constructs an empty clause database, ready to have clauses added to it
+*/
+CNF::CNF()
+    : offsets(1, 0), mapping(NULL), mappingSize(0), numLiterals(0), numClauses(0), numVars(0)
+{
+    attachOwned();
+}
 
 /*
- Reads in and stores specifically formatted (.cnf) conjunctive normal form problem information
- to evaluate the satisfiability of those closes in the MAXSAT problem
+ Unmaps the binary cache, if the database came from one
+*/
+CNF::~CNF()
+{
+    releaseMapping();
+}
+
+/*
+ Appends a literal to the clause currently being built
  Parameters:
-        fp: the path of the file to be read in
- Returns the integer value representing the number of variables found in the problem
+        lit: The DIMACS literal (a nonzero, possibly negated, 1-based variable index)
+*/
+void CNF::addLiteral(int lit)
+{
+    if (abs(lit) > numVars) numVars = abs(lit);
+    literals.push_back(encodeLiteral(lit));
+    attachOwned();
+}
+
+/*
+ Closes the clause currently being built. Empty clauses are ignored.
+*/
+void CNF::endClause()
+{
+    if (literals.size() != offsets.back())
+        offsets.push_back(literals.size());
+    attachOwned();
+}
+
+/*
+ Points the database at the arrays owned by this CNF, after they have been filled
+ or have grown
+*/
+void CNF::attachOwned()
+{
+    literalData = literals.data();
+    offsetData = offsets.data();
+    occurrenceData = occurrences.data();
+    occurrenceOffsetData = occurrenceOffsets.data();
+    numLiterals = literals.size();
+    numClauses = static_cast<int>(offsets.size()) - 1;
+}
+
+/*
+ Unmaps the binary cache (if any), leaving the database pointing at its own arrays
+*/
+void CNF::releaseMapping()
+{
+    if (mapping)
+        munmap(mapping, mappingSize);
+    mapping = NULL;
+    mappingSize = 0;
+    attachOwned();
+}
+
+/*
+ Builds the variable-to-clause occurrence index with a counting pass followed
+ by a placement pass, so it takes two linear scans over the literals
+*/
+void CNF::buildOccurrences()
+{
+    occurrenceOffsets.assign(numVars + 1, 0);
+    for (size_t i = 0; i < numLiterals; i++)
+        occurrenceOffsets[literalVar(literalData[i]) + 1]++;
+    for (int v = 0; v < numVars; v++)
+        occurrenceOffsets[v + 1] += occurrenceOffsets[v];
+    
+    occurrences.resize(numLiterals);
+    std::vector<unsigned int> next(occurrenceOffsets.begin(), occurrenceOffsets.end() - 1);
+    for (int c = 0; c < numClauses; c++) {
+        for (unsigned int j = offsetData[c]; j < offsetData[c + 1]; j++) {
+            unsigned int lit = literalData[j];
+            occurrences[next[literalVar(lit)]++] = (static_cast<unsigned int>(c) << 1) | (lit & 1);
+        }
+    }
+    occurrenceData = occurrences.data();
+    occurrenceOffsetData = occurrenceOffsets.data();
+}
+
+/*
+ Returns the number of bytes held by the literal, offset, and occurrence arrays,
+ including the mapped cache file (which is shared with the page cache)
+*/
+size_t CNF::memoryUsage() const
+{
+    return literals.capacity() * sizeof(unsigned int)
+         + offsets.capacity() * sizeof(unsigned int)
+         + occurrences.capacity() * sizeof(unsigned int)
+         + occurrenceOffsets.capacity() * sizeof(unsigned int)
+         + mappingSize;
+}
+
+// Layout of the binary cache file: this header, then the clause offsets
+// (numClauses + 1 entries), the literals (numLiterals), the occurrence offsets
+// (numVars + 1), and the occurrences (numLiterals), all as native unsigned ints.
+// The size and modification time of the .cnf it was built from are recorded so a
+// stale cache is ignored. Bump CACHE_VERSION whenever the layout or encoding changes.
+static const char CACHE_MAGIC[8] = { 'M', 'A', 'X', 'S', 'A', 'T', 'B', 'N' };
+static const uint32_t CACHE_VERSION = 1;
+
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t numVars;
+    uint32_t numClauses;
+    uint32_t unitSize;
+    uint64_t numLiterals;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+};
+
+/*
+ Returns the total size in bytes of a cache file with the given header
+*/
+static uint64_t cacheFileSize(const CacheHeader& header)
+{
+    uint64_t units = (header.numClauses + 1ULL) + header.numLiterals
+                   + (header.numVars + 1ULL) + header.numLiterals;
+    return sizeof(CacheHeader) + units * sizeof(unsigned int);
+}
+
+/*
+ Checks that an index laid out like the clause database (an offsets array starting at 0,
+ never decreasing and ending at the number of entries) only refers to entries below a
+ limit, so that a corrupt cache can't send the evaluators out of bounds
+ Parameters:
+        offsets: The numGroups + 1 offsets
+        entries: The entries the offsets index into
+        numGroups: The number of clauses (or variables) indexed
+        numEntries: The number of entries
+        limit: Bound on each entry, which is checked after dropping its low (sign) bit
+ Returns whether the index is well formed
+*/
+static bool validIndex(const unsigned int* offsets, const unsigned int* entries,
+                       uint64_t numGroups, uint64_t numEntries, uint64_t limit)
+{
+    if (offsets[0] != 0 || offsets[numGroups] != numEntries)
+        return false;
+    for (uint64_t i = 0; i < numGroups; i++) {
+        if (offsets[i] > offsets[i + 1])
+            return false;
+    }
+    for (uint64_t i = 0; i < numEntries; i++) {
+        if ((entries[i] >> 1) >= limit)
+            return false;
+    }
+    return true;
+}
+
+/*
+ Maps a binary cache file and points the database straight into it, without
+ parsing or copying anything. Its offsets, literals and occurrence index are checked
+ (see validIndex) before they are used
+ Parameters:
+        cachePath: The cache file
+        sourceSize, sourceTime: Size and modification time (in nanoseconds) of the .cnf
+            file, which must match those recorded in the cache
+ Returns whether the cache was present, current, and well formed
 */
-int readClauses(std::string fp)
+bool CNF::mapCache(const std::string& cachePath, uint64_t sourceSize, int64_t sourceTime)
 {
-    filepath = fp;
-    int maxVal = 0;
+    int fd = open(cachePath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    
+    struct stat info;
+    CacheHeader header;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(CacheHeader)
+        || pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))
+        || memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0
+        || header.version != CACHE_VERSION || header.unitSize != sizeof(unsigned int)
+        || header.sourceSize != sourceSize || header.sourceTime != sourceTime
+        || header.numVars > INT_MAX || header.numClauses > INT_MAX || header.numLiterals > UINT_MAX
+        || cacheFileSize(header) != static_cast<uint64_t>(info.st_size)) {
+        close(fd);
+        return false;
+    }
     
-    std::fstream file(filepath);
-    std::stringstream ss;
+    void* mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
     
-    if (file.is_open()) {
-        std::vector<int> newClause;
-        int val;
-        std::string line;
+    const unsigned int* data = reinterpret_cast<const unsigned int*>(static_cast<const char*>(mapped) + sizeof(CacheHeader));
+    const unsigned int* cachedOffsets = data;
+    const unsigned int* cachedLiterals = cachedOffsets + header.numClauses + 1;
+    const unsigned int* cachedOccurrenceOffsets = cachedLiterals + header.numLiterals;
+    const unsigned int* cachedOccurrences = cachedOccurrenceOffsets + header.numVars + 1;
+    if (!validIndex(cachedOffsets, cachedLiterals, header.numClauses, header.numLiterals, header.numVars)
+        || !validIndex(cachedOccurrenceOffsets, cachedOccurrences, header.numVars, header.numLiterals, header.numClauses)) {
+        munmap(mapped, info.st_size);
+        return false;
+    }
+    
+    literals.clear();
+    offsets.clear();
+    occurrences.clear();
+    occurrenceOffsets.clear();
+    releaseMapping();
+    mapping = mapped;
+    mappingSize = info.st_size;
+    
+    numVars = header.numVars;
+    numClauses = header.numClauses;
+    numLiterals = header.numLiterals;
+    offsetData = cachedOffsets;
+    literalData = cachedLiterals;
+    occurrenceOffsetData = cachedOccurrenceOffsets;
+    occurrenceData = cachedOccurrences;
+    return true;
+}
+
+/*
+ Writes the database out as a binary cache file. The file is written under a
+ temporary name and renamed into place, so concurrent runs never see a partial
+ cache. Failures (e.g. a read-only directory) are ignored, since the cache only
+ speeds up later runs.
+ Parameters:
+        cachePath: The cache file
+        sourceSize, sourceTime: Size and modification time (in nanoseconds) of the .cnf
+            file the database was parsed from
+*/
+void CNF::writeCache(const std::string& cachePath, uint64_t sourceSize, int64_t sourceTime) const
+{
+    CacheHeader header;
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = CACHE_VERSION;
+    header.numVars = numVars;
+    header.numClauses = numClauses;
+    header.unitSize = sizeof(unsigned int);
+    header.numLiterals = numLiterals;
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    
+    std::ostringstream tempPath;
+    tempPath << cachePath << ".tmp" << getpid();
+    FILE* file = fopen(tempPath.str().c_str(), "wb");
+    if (!file)
+        return;
+    
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(offsetData, sizeof(unsigned int), numClauses + 1, file) == static_cast<size_t>(numClauses + 1)
+        && fwrite(literalData, sizeof(unsigned int), numLiterals, file) == numLiterals
+        && fwrite(occurrenceOffsetData, sizeof(unsigned int), numVars + 1, file) == static_cast<size_t>(numVars + 1)
+        && fwrite(occurrenceData, sizeof(unsigned int), numLiterals, file) == numLiterals;
+    ok = (fclose(file) == 0) && ok;
+    
+    if (!ok || rename(tempPath.str().c_str(), cachePath.c_str()) != 0)
+        unlink(tempPath.str().c_str());
+}
+
+// The clauses parsed from one chunk of a .cnf file, before being stitched into the CNF
+struct ParsedChunk {
+    std::vector<unsigned int> literals;
+    std::vector<unsigned int> clauseEnds;   // end of each clause within literals
+    int maxVar;
+    int headerVars;
+    int headerClauses;
+    
+    ParsedChunk() : maxVar(0), headerVars(-1), headerClauses(-1) {}
+};
+
+/*
+ Scans an optionally signed decimal integer, advancing pos past it
+ Parameters:
+        pos: Position of the first character of the integer, advanced past its end
+        end: End of the text
+        value: Output, the integer scanned
+ Returns whether an integer was found at pos
+*/
+static bool scanInt(const char*& pos, const char* end, long& value)
+{
+    const char* p = pos;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    if (p == end || *p < '0' || *p > '9')
+        return false;
+    
+    long v = 0;
+    while (p < end && *p >= '0' && *p <= '9')
+        v = v * 10 + (*p++ - '0');
+    
+    value = negative ? -v : v;
+    pos = p;
+    return true;
+}
+
+/*
+ Skips to the start of the next line
+*/
+static const char* skipLine(const char* pos, const char* end)
+{
+    const char* newline = static_cast<const char*>(memchr(pos, '\n', end - pos));
+    return newline ? newline + 1 : end;
+}
+
+/*
+ Parses the DIMACS text in [begin, end), which must start at the start of a line.
+ "c" lines are comments, the "p cnf <vars> <clauses>" header is recorded, "%" ends
+ the formula (as in the SATLIB benchmarks), and every other token is a literal, with
+ 0 ending the current clause wherever it appears, so clauses may span lines. Lines
+ holding anything else are skipped from the unexpected character on.
+ Parameters:
+        begin, end: The text to parse
+        out: Output, the clauses parsed. A clause left open at the end is closed
+ Returns whether a "%" line ended the formula
+*/
+static bool parseChunk(const char* begin, const char* end, ParsedChunk& out)
+{
+    const char* pos = begin;
+    bool lineStart = true;
+    bool finished = false;
+    
+    while (pos < end) {
+        char ch = *pos;
+        if (ch == '\n') {
+            lineStart = true;
+            pos++;
+            continue;
+        }
+        if (ch == ' ' || ch == '\t' || ch == '\r') {
+            pos++;
+            continue;
+        }
         
-        //For each clause in the file
-        while (getline(file, line)) {
-            
-            ss.clear(); //clear fail flags
-            ss.str(""); //empty stream
-            ss << line; //read entire clause into stream
-            
-            // While there are still integers and a '0' has not been encountered,
-            // build the new clause
-            while (ss >> val && val != 0) {
-                if (val > maxVal) maxVal = val;
-                newClause.push_back(val);
-            }
-            
-            // If a valid clause, add clause to SAT data
-            if (!newClause.empty()) {
-                clauses.push_back(newClause);
-                newClause.clear();
+        // Comments, the header, and the end marker are only recognized at the
+        // start of a line
+        if (lineStart && ch == 'c') {
+            pos = skipLine(pos, end);
+            continue;
+        }
+        if (lineStart && ch == 'p') {
+            const char* p = pos + 1;
+            while (p < end && (*p == ' ' || *p == '\t')) p++;
+            if (end - p >= 3 && memcmp(p, "cnf", 3) == 0) {
+                p += 3;
+                long vars, clauses;
+                while (p < end && (*p == ' ' || *p == '\t')) p++;
+                if (scanInt(p, end, vars)) {
+                    while (p < end && (*p == ' ' || *p == '\t')) p++;
+                    if (scanInt(p, end, clauses)) {
+                        out.headerVars = vars;
+                        out.headerClauses = clauses;
+                    }
+                }
             }
+            pos = skipLine(pos, end);
+            continue;
         }
+        if (lineStart && ch == '%') {
+            finished = true;
+            break;
+        }
+        lineStart = false;
         
-    // Error checking
-    } else {
+        long val;
+        if (!scanInt(pos, end, val)) {
+            pos = skipLine(pos, end);
+            lineStart = true;
+            continue;
+        }
+        
+        if (val == 0) {
+            if (out.literals.size() != (out.clauseEnds.empty() ? 0 : out.clauseEnds.back()))
+                out.clauseEnds.push_back(out.literals.size());
+        } else {
+            int lit = static_cast<int>(val);
+            if (abs(lit) > out.maxVar) out.maxVar = abs(lit);
+            out.literals.push_back(CNF::encodeLiteral(lit));
+        }
+    }
+    
+    // Close a final clause missing its terminating 0
+    if (out.literals.size() != (out.clauseEnds.empty() ? 0 : out.clauseEnds.back()))
+        out.clauseEnds.push_back(out.literals.size());
+    return finished;
+}
+
+/*
+ Finds a place to split the text at or after pos where a new chunk can start parsing:
+ just after a clause-ending 0 and at the start of a line, so no clause or comment is
+ cut in two. Scanning starts at the next line, and skips comment and header lines.
+ Parameters:
+        pos: Where to start looking
+        end: End of the text
+ Returns the split point, or end if there is none
+*/
+static const char* findSplit(const char* pos, const char* end)
+{
+    pos = skipLine(pos, end);
+    while (pos < end) {
+        if (*pos == 'c' || *pos == 'p' || *pos == '%') {
+            pos = skipLine(pos, end);
+            continue;
+        }
+        
+        // Look for a 0 token on this line; the split goes at the start of the next line
+        const char* lineEnd = skipLine(pos, end);
+        const char* p = pos;
+        while (p < lineEnd) {
+            if (*p == '0' && (p == pos || p[-1] == ' ' || p[-1] == '\t')
+                && (p + 1 == lineEnd || p[1] == ' ' || p[1] == '\t' || p[1] == '\r' || p[1] == '\n')) {
+                // The rest of the line after the 0 must be blank, so that it is
+                // not the start of the next clause
+                const char* q = p + 1;
+                while (q < lineEnd && (*q == ' ' || *q == '\t' || *q == '\r' || *q == '\n')) q++;
+                if (q == lineEnd)
+                    return lineEnd;
+            }
+            p++;
+        }
+        pos = lineEnd;
+    }
+    return end;
+}
+
+/*
+ Reads in and stores specifically formatted (.cnf) conjunctive normal form problem information
+ to evaluate the satisfiability of those closes in the MAXSAT problem. The file is memory
+ mapped and scanned directly, without iostreams. Storage is preallocated from the
+ "p cnf" header and the file size, and large files can be split into chunks that are
+ parsed in parallel and then stitched together in order.
+ The parsed database is also written to a binary cache file (the path with ".bin"
+ appended). Later runs on an unchanged file map that cache straight into the
+ database instead of parsing, so startup takes milliseconds even on big instances.
+ Deleting the cache file is always safe.
+ Parameters:
+        fp: the path of the file to be read in
+        cnf: the clause database to fill
+        numThreads: the number of threads to parse with
+ Returns the integer value representing the number of variables in the problem (from
+ the header, or the largest variable used if that is larger)
+*/
+int readClauses(std::string fp, CNF& cnf, int numThreads)
+{
+    cnf.filepath = fp;
+    
+    int fd = open(fp.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
         std::cout << "File did not open properly" << std::endl;
         exit(1);
     }
     
-    file.close();
+    // Use the binary cache next to the file when it is up to date
+    std::string cachePath = fp + ".bin";
+    uint64_t sourceSize = info.st_size;
+    int64_t sourceTime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    if (cnf.mapCache(cachePath, sourceSize, sourceTime)) {
+        close(fd);
+        return cnf.numVars;
+    }
+    
+    // Otherwise map the whole text file into memory and parse it
+    size_t size = info.st_size;
+    const char* text = NULL;
+    if (size > 0) {
+        void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            std::cout << "File did not open properly" << std::endl;
+            exit(1);
+        }
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        text = static_cast<const char*>(mapped);
+    }
+    close(fd);
+    const char* end = text + size;
+    
+    // Split the file into chunks of at least a few megabytes, one per thread, at
+    // clause boundaries
+    const size_t minChunk = 4 << 20;
+    int numChunks = std::max(1, std::min(numThreads, static_cast<int>(size / minChunk)));
+    std::vector<const char*> splits(1, text);
+    for (int i = 1; i < numChunks; i++) {
+        const char* split = findSplit(std::max(splits.back(), text + size * i / numChunks), end);
+        if (split < end)
+            splits.push_back(split);
+    }
+    splits.push_back(end);
+    numChunks = splits.size() - 1;
+    
+    // Parse the chunks, reserving roughly one literal per 4 bytes of text
+    std::vector<ParsedChunk> chunks(numChunks);
+    std::vector<char> finished(numChunks, 0);
+    ThreadPool pool(numChunks);
+    pool.run(numChunks, [&](int i) {
+        chunks[i].literals.reserve((splits[i + 1] - splits[i]) / 4);
+        finished[i] = parseChunk(splits[i], splits[i + 1], chunks[i]);
+    });
+    
+    // Stitch the chunks together in order, stopping at a "%" end marker
+    size_t numLiterals = 0;
+    size_t numClauses = 0;
+    int headerVars = -1;
+    int headerClauses = -1;
+    for (int i = 0; i < numChunks; i++) {
+        numLiterals += chunks[i].literals.size();
+        numClauses += chunks[i].clauseEnds.size();
+        if (headerVars < 0) {
+            headerVars = chunks[i].headerVars;
+            headerClauses = chunks[i].headerClauses;
+        }
+        if (finished[i]) break;
+    }
+    
+    cnf.releaseMapping();
+    cnf.literals.clear();
+    cnf.offsets.assign(1, 0);
+    cnf.literals.reserve(numLiterals);
+    cnf.offsets.reserve(std::max<size_t>(numClauses, headerClauses > 0 ? headerClauses : 0) + 1);
+    cnf.numVars = std::max(0, headerVars);
+    for (int i = 0; i < numChunks; i++) {
+        unsigned int base = cnf.literals.size();
+        cnf.literals.insert(cnf.literals.end(), chunks[i].literals.begin(), chunks[i].literals.end());
+        for (unsigned int j = 0; j < chunks[i].clauseEnds.size(); j++)
+            cnf.offsets.push_back(base + chunks[i].clauseEnds[j]);
+        cnf.numVars = std::max(cnf.numVars, chunks[i].maxVar);
+        
+        // Release each chunk as soon as it is copied
+        std::vector<unsigned int>().swap(chunks[i].literals);
+        std::vector<unsigned int>().swap(chunks[i].clauseEnds);
+        if (finished[i]) break;
+    }
+    
+    if (text)
+        munmap(const_cast<char*>(text), size);
+    
+    // Trim the growth slack so the database holds only the literals themselves
+    cnf.literals.shrink_to_fit();
+    cnf.offsets.shrink_to_fit();
+    cnf.attachOwned();
+    cnf.buildOccurrences();
+    cnf.writeCache(cachePath, sourceSize, sourceTime);
     
     // Return the number of variables found in the problem file
-    return maxVal;
+    return cnf.numVars;
 }
 
 
 /*
  Prints the CNF clauses data after it has been read it, for testing purposes
 */
-void printClauses(std::vector<std::vector<int>>& data)
+void CNF::print() const
 {
-    for (unsigned int i = 0; i < data.size(); i++) {
+    for (int i = 0; i < getNumClauses(); i++) {
         std::cout << i << ": ";
-        for (unsigned int j = 0; j < data[i].size(); j++) {
-            std::cout << data[i][j] << " ";
+        for (const unsigned int* lit = clauseBegin(i); lit != clauseEnd(i); ++lit) {
+            std::cout << decodeLiteral(*lit) << " ";
         }
         std::cout << std::endl;
     }
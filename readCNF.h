@@ -3,8 +3,8 @@
 #include <string>
 #include <vector>
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <cstdlib>
+#include <cstdint>
 
 /*
  
@@ -17,12 +17,86 @@
  See readCNF.cpp for more documentation. 
 */
 
-// Globals set by readClauses. MAXSAT individuals need to access clauses, while
-// printing in the algorithms must display the filepath. This global access helps
-// keep the algorithms problem independent.
-extern std::vector<std::vector<int>> clauses;
-extern std::string filepath;
+// A MAXSAT problem stored as a flat (compressed sparse row) clause database.
+// All literals of all clauses live in one contiguous array, and clause i spans
+// literals[offsets[i]] up to (but not including) literals[offsets[i + 1]], so
+// evaluating an assignment is a single linear scan over memory.
+// Literals are pre-encoded as (var << 1) | sign, where var is zero based and
+// sign is 1 for a negated literal.
+// An occurrence index maps each variable to the clauses it appears in, stored the
+// same way: variable v's entries are occurrences[occurrenceOffsets[v]] up to
+// occurrences[occurrenceOffsets[v + 1]], each encoded as (clause << 1) | sign.
+// The arrays are either owned by the CNF (when parsed from text) or point straight
+// into a memory mapped binary cache file (see readClauses), so a CNF is not copyable.
+class CNF {
+public:
+    CNF();
+    ~CNF();
 
-int readClauses(std::string filepath_);
-void printClauses(std::vector<std::vector<int>>& data);
+    // Encoding and decoding of literals between DIMACS form (e.g. -3) and the
+    // packed (var, sign) form stored in the clause database
+    static unsigned int encodeLiteral(int lit) { return (static_cast<unsigned int>(abs(lit) - 1) << 1) | (lit < 0 ? 1 : 0); }
+    static int decodeLiteral(unsigned int code) { return (code & 1) ? -static_cast<int>((code >> 1) + 1) : static_cast<int>((code >> 1) + 1); }
+    static int literalVar(unsigned int code) { return code >> 1; }
+    static bool literalNegated(unsigned int code) { return code & 1; }
 
+    // Builds the database one literal at a time, closing a clause with endClause
+    void addLiteral(int lit);
+    void endClause();
+
+    int getNumVars() const { return numVars; }
+    int getNumClauses() const { return numClauses; }
+    size_t getNumLiterals() const { return numLiterals; }
+    const std::string& getFilepath() const { return filepath; }
+    // Whether the database was mapped from a binary cache instead of parsed
+    bool isMapped() const { return mapping != NULL; }
+
+    // Raw access to the clause database for evaluation loops
+    const unsigned int* getLiterals() const { return literalData; }
+    const unsigned int* getOffsets() const { return offsetData; }
+    const unsigned int* clauseBegin(int clause) const { return literalData + offsetData[clause]; }
+    const unsigned int* clauseEnd(int clause) const { return literalData + offsetData[clause + 1]; }
+
+    // Occurrence index access, valid once buildOccurrences has been called
+    void buildOccurrences();
+    const unsigned int* occurrenceBegin(int var) const { return occurrenceData + occurrenceOffsetData[var]; }
+    const unsigned int* occurrenceEnd(int var) const { return occurrenceData + occurrenceOffsetData[var + 1]; }
+
+    // Bytes used by the clause database and occurrence index (not counting the filepath)
+    size_t memoryUsage() const;
+
+    void print() const;
+
+private:
+    friend int readClauses(std::string filepath_, CNF& cnf, int numThreads);
+    friend class Preprocessor;
+
+    CNF(const CNF&);
+    CNF& operator=(const CNF&);
+
+    void attachOwned();
+    void releaseMapping();
+    bool mapCache(const std::string& cachePath, uint64_t sourceSize, int64_t sourceTime);
+    void writeCache(const std::string& cachePath, uint64_t sourceSize, int64_t sourceTime) const;
+
+    // Storage for a database built in memory
+    std::vector<unsigned int> literals;
+    std::vector<unsigned int> offsets;
+    std::vector<unsigned int> occurrences;
+    std::vector<unsigned int> occurrenceOffsets;
+
+    // The arrays in use, pointing either into the vectors above or into the mapping
+    const unsigned int* literalData;
+    const unsigned int* offsetData;
+    const unsigned int* occurrenceData;
+    const unsigned int* occurrenceOffsetData;
+    void* mapping;
+    size_t mappingSize;
+
+    size_t numLiterals;
+    int numClauses;
+    int numVars;
+    std::string filepath;
+};
+
+int readClauses(std::string filepath_, CNF& cnf, int numThreads = 1);